@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+/**
+ * Bump allocator over a chain of retained blocks.
+ *
+ * `reset()` only rewinds to the first block, blocks are kept and reused in order, so
+ * once a workload has grown the chain to its peak it never touches the heap again.
+ * Derives from `std::pmr::memory_resource` so pmr containers can live in it;
+ * deallocation is a no-op and destructors of arena objects are never run.
+ */
+class MonotonicArena final : public std::pmr::memory_resource {
+public:
+    explicit MonotonicArena(std::size_t block_bytes = 64 * 1024) noexcept;
+    ~MonotonicArena() override;
+
+    MonotonicArena(MonotonicArena&& other) noexcept;
+    MonotonicArena& operator=(MonotonicArena&& other) noexcept;
+
+    MonotonicArena(const MonotonicArena&)            = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+    void reset() noexcept;
+
+    // uninitialised storage for `n` objects, only for types that need no destructor
+    template <class T>
+    T* alloc_array(std::size_t n)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "arena memory is never destroyed");
+        return static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+    }
+
+    std::size_t bytes_used() const noexcept { return used_before + offset; }
+    std::size_t bytes_reserved() const noexcept { return reserved; }
+
+private:
+    struct Block {
+        Block* next;
+        std::size_t size; // usable bytes after the header
+    };
+
+    void* do_allocate(std::size_t bytes, std::size_t align) override;
+    void do_deallocate(void*, std::size_t, std::size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    std::byte* block_data(Block* b) const noexcept;
+    Block* new_block(std::size_t min_bytes);
+    void release() noexcept;
+
+    std::size_t block_bytes;
+    Block* head = nullptr;
+    Block* current = nullptr;
+    std::size_t offset = 0;        // into `current`
+    std::size_t used_before = 0;   // bytes in blocks before `current`
+    std::size_t reserved = 0;
+};
+
+
+/**
+ * Per-tick scratch memory: one shared arena plus one sub-arena per pool worker,
+ * so parallel builds can allocate without synchronising. Reset at tick start.
+ */
+class TickArena {
+public:
+    TickArena();
+
+    void reset() noexcept;
+
+    MonotonicArena& shared() noexcept { return main; }
+    MonotonicArena& local(unsigned worker) noexcept { return locals[worker]; }
+
+private:
+    MonotonicArena main;
+    std::vector<MonotonicArena> locals;
+};
+
+
+/**
+ * Contiguous typed storage for long-lived objects such as models. Objects are
+ * constructed in place, iterated densely and destroyed together. Addresses are
+ * stable until the pool has to grow past its reserved capacity.
+ */
+template <class T>
+class ObjectPool {
+public:
+    ObjectPool() = default;
+    explicit ObjectPool(std::size_t capacity) { reserve(capacity); }
+    ~ObjectPool() { clear(); deallocate(); }
+
+    ObjectPool(ObjectPool&& other) noexcept
+        : items(std::exchange(other.items, nullptr)),
+          count(std::exchange(other.count, 0)),
+          cap(std::exchange(other.cap, 0))
+    {}
+    ObjectPool& operator=(ObjectPool&& other) noexcept
+    {
+        if (this != &other) {
+            clear();
+            deallocate();
+            items = std::exchange(other.items, nullptr);
+            count = std::exchange(other.count, 0);
+            cap   = std::exchange(other.cap, 0);
+        }
+        return *this;
+    }
+
+    ObjectPool(const ObjectPool&)            = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    void reserve(std::size_t n)
+    {
+        static_assert(std::is_nothrow_move_constructible_v<T>, "pool relocation must not throw");
+        if (n <= cap)
+            return;
+
+        T* fresh = static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{alignof(T)}));
+        for (std::size_t i=0; i<count; ++i) {
+            ::new (fresh + i) T(std::move(items[i]));
+            items[i].~T();
+        }
+        deallocate();
+        items = fresh;
+        cap = n;
+    }
+
+    template <class... Args>
+    T& emplace(Args&&... args)
+    {
+        if (count == cap)
+            reserve(cap ? cap * 2 : 8);
+        T* obj = ::new (items + count) T(std::forward<Args>(args)...);
+        ++count;
+        return *obj;
+    }
+
+    void clear() noexcept
+    {
+        for (std::size_t i=count; i>0; --i)
+            items[i - 1].~T();
+        count = 0;
+    }
+
+    T* begin() noexcept { return items; }
+    T* end() noexcept { return items + count; }
+    const T* begin() const noexcept { return items; }
+    const T* end() const noexcept { return items + count; }
+
+    T& operator[](std::size_t i) noexcept { return items[i]; }
+    const T& operator[](std::size_t i) const noexcept { return items[i]; }
+
+    std::size_t size() const noexcept { return count; }
+    std::size_t capacity() const noexcept { return cap; }
+
+private:
+    void deallocate() noexcept
+    {
+        if (items)
+            ::operator delete(items, std::align_val_t{alignof(T)});
+        items = nullptr;
+        cap = 0;
+    }
+
+    T* items = nullptr;
+    std::size_t count = 0;
+    std::size_t cap = 0;
+};
@@ -5,6 +5,8 @@
 constexpr int kWidth = 1280;
 constexpr int kHeight = 720;
 
+constexpr float kGravity = 10.0f;
+
 constexpr int kNumObjects = 3;
 
 constexpr glm::vec3 colours[kNumObjects] = {
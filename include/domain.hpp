@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+struct State;
+struct SharedHeader;
+
+
+struct DomainConfig {
+    std::uint32_t num_domains = 4;
+    // Barnes-Hut style opening angle used against other domains' summaries,
+    // 0 forces exact pair sums across every domain boundary, matching State::tick
+    float opening_angle = 0.0f;
+    // slowest domain's work over the mean, beyond which bodies are re-sorted and re-split by cost
+    float max_imbalance = 0.1f;
+};
+
+struct DomainStats {
+    std::vector<std::uint64_t> work_ns;   // measured force time per domain, last tick
+    std::vector<std::uint32_t> counts;    // bodies owned per domain, last tick
+    std::uint32_t migrated = 0;           // bodies that changed domain on the last tick
+    bool resplit = false;                 // whether the split keys were recomputed on the last tick
+};
+
+
+/**
+ * Splits the body set of a `State` across forked worker processes on one Linux host.
+ *
+ * Bodies are ordered along a Morton curve and every domain owns a contiguous run of
+ * that order, i.e. a range of keys. The split keys and the quantisation frame are kept
+ * between ticks, so a tick only moves the bodies whose key crossed a split; bodies are
+ * sorted and the splits recomputed from measured work when the load becomes uneven.
+ * Positions and props live in a POSIX shared memory segment, each domain publishes a
+ * monopole summary of itself and the others either open it (exact pair sums) or use
+ * the summary when it is far enough away.
+ *
+ * The calling process acts as domain 0 and coordinator, so `num_domains - 1` children
+ * are forked. Each domain integrates on one thread, forked children cannot use the
+ * thread pool. The body count is fixed for the lifetime of the decomposition.
+ */
+class DomainDecomposition {
+public:
+    DomainDecomposition(const State& state, DomainConfig config);
+    ~DomainDecomposition();
+
+    void tick(State& state, float dt);
+    // keeps per-body bookkeeping aligned after `State` permuted its bodies
+    void on_reorder(const std::vector<std::uint32_t>& new_to_old);
+
+    const DomainStats& stats() const noexcept { return stats_; }
+
+    DomainDecomposition(const DomainDecomposition&)            = delete;
+    DomainDecomposition& operator=(const DomainDecomposition&) = delete;
+
+private:
+    bool update_frame(const State& state);
+    void gather(const State& state, std::pmr::memory_resource* scratch);
+    void split_by_cost(std::pmr::memory_resource* scratch);
+    void partition_by_key();
+    void scatter(State& state) const;
+    void rebalance();
+    void abandon() noexcept;
+
+    DomainConfig config;
+    std::size_t num_bodies;
+
+    SharedHeader* shared = nullptr;
+    std::size_t shared_bytes = 0;
+    std::vector<int> workers;               // child pids
+
+    // coordinator-side scratch, reused every tick
+    glm::vec3 frame_lo{std::numeric_limits<float>::max()};    // Morton frame, kept between ticks
+    glm::vec3 frame_hi{std::numeric_limits<float>::lowest()};
+    glm::vec3 frame_inv_extent{0};
+    std::vector<std::uint32_t> keys, keys_tmp;      // Morton key per slot
+    std::vector<std::uint32_t> slot_ids, slot_tmp;  // slot -> body index, grouped by domain
+    std::vector<std::uint32_t> split_keys;          // first key of each domain, [0] unused
+    std::vector<std::uint32_t> domain_counts;
+    bool needs_split = true;
+    std::vector<std::uint32_t> domain_of;   // body index -> domain
+    std::vector<float> body_cost;           // body index -> measured ns
+    std::vector<std::uint32_t> reorder_domain_of;
+    std::vector<float> reorder_cost;
+
+    DomainStats stats_;
+};
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <cmath>
+#include <concepts>
+#include <type_traits>
+
+#include <glm/glm.hpp>
+
+#include "constants.hpp"
+
+
+/**
+ * Compile-time force laws.
+ *
+ * A law is a small value type exposing any of
+ *   glm::vec3 pair(const P& self, const P& other, const glm::vec3& r, float r_sq) const
+ *       acceleration on `self` from `other`, with r = other.pos - self.pos
+ *   glm::vec3 body(const P& self, const glm::vec3& pos) const
+ *       acceleration that does not depend on other bodies
+ * and a `fields` FieldList naming the per-body properties it reads. Laws are
+ * combined with `+` into a `Compose<A, B>`; everything is resolved statically so
+ * the composed kernel inlines into the integration loops with no dispatch.
+ * `PhysicsProps` (see physics_config.hpp) only stores the union of the fields.
+ */
+
+
+// ---- per-body fields ---------------------------------------------------------
+
+namespace fields
+{
+struct Mass {
+    float mass = 1.0f;
+    static void accumulate(Mass& sum, const Mass& x) { sum.mass += x.mass; }
+};
+
+struct Charge {
+    float charge = 0.0f;
+    static void accumulate(Charge& sum, const Charge& x) { sum.charge += x.charge; }
+};
+}
+
+template <class... Fields>
+struct FieldList {};
+
+namespace detail
+{
+template <class T, class... Ts>
+constexpr bool contains_v = (std::is_same_v<T, Ts> || ...);
+
+template <class Acc, class... Rest>
+struct Union;
+
+template <class... Acc>
+struct Union<FieldList<Acc...>> {
+    using type = FieldList<Acc...>;
+};
+
+template <class... Acc, class F, class... Rest>
+struct Union<FieldList<Acc...>, F, Rest...> {
+    using type = typename std::conditional_t<contains_v<F, Acc...>,
+                                             Union<FieldList<Acc...>, Rest...>,
+                                             Union<FieldList<Acc..., F>, Rest...>>::type;
+};
+
+template <class A, class B>
+struct Merge;
+
+template <class... A, class... B>
+struct Merge<FieldList<A...>, FieldList<B...>> {
+    using type = typename Union<FieldList<>, A..., B...>::type;
+};
+}
+
+template <class A, class B>
+using merge_fields_t = typename detail::Merge<A, B>::type;
+
+
+template <class List>
+struct BodyProps;
+
+// velocity is always present, everything else only when some law reads it
+template <class... Fields>
+struct BodyProps<FieldList<Fields...>> : Fields... {
+    glm::vec3 vel{0};
+
+    // sums every field of `x` into this, used for far-field pseudo-bodies
+    void accumulate(const BodyProps& x) { (Fields::accumulate(*this, x), ...); }
+};
+
+template <class Props, class Field>
+constexpr bool has_field_v = std::is_base_of_v<Field, Props>;
+
+// mass where the active law stores it, unit mass otherwise
+template <class Props>
+float mass_of(const Props& p)
+{
+    if constexpr (has_field_v<Props, fields::Mass>)
+        return p.mass;
+    else
+        return 1.0f;
+}
+
+
+// ---- law detection and composition -------------------------------------------
+
+template <class Law, class P>
+concept HasPair = requires(const Law& law, const P& p, const glm::vec3& r) {
+    { law.pair(p, p, r, 1.0f) } -> std::convertible_to<glm::vec3>;
+};
+
+template <class Law, class P>
+concept HasBody = requires(const Law& law, const P& p, const glm::vec3& x) {
+    { law.body(p, x) } -> std::convertible_to<glm::vec3>;
+};
+
+template <class Law>
+concept ForceLawType = requires { typename Law::fields; };
+
+template <class Law, class P>
+inline glm::vec3 pair_accel(const Law& law, const P& self, const P& other, const glm::vec3& r, float r_sq)
+{
+    if constexpr (HasPair<Law, P>)
+        return law.pair(self, other, r, r_sq);
+    else
+        return glm::vec3{0};
+}
+
+template <class Law, class P>
+inline glm::vec3 body_accel(const Law& law, const P& self, const glm::vec3& pos)
+{
+    if constexpr (HasBody<Law, P>)
+        return law.body(self, pos);
+    else
+        return glm::vec3{0};
+}
+
+template <class A, class B>
+struct Compose {
+    using fields = merge_fields_t<typename A::fields, typename B::fields>;
+
+    A a;
+    B b;
+
+    template <class P>
+        requires (HasPair<A, P> || HasPair<B, P>)
+    glm::vec3 pair(const P& self, const P& other, const glm::vec3& r, float r_sq) const
+    {
+        return pair_accel(a, self, other, r, r_sq) + pair_accel(b, self, other, r, r_sq);
+    }
+
+    template <class P>
+        requires (HasBody<A, P> || HasBody<B, P>)
+    glm::vec3 body(const P& self, const glm::vec3& pos) const
+    {
+        return body_accel(a, self, pos) + body_accel(b, self, pos);
+    }
+};
+
+template <ForceLawType A, ForceLawType B>
+constexpr Compose<A, B> operator+(const A& a, const B& b)
+{
+    return Compose<A, B>{a, b};
+}
+
+
+// ---- softening policies --------------------------------------------------------
+
+// 1 / |r|^3 as is, singular at r = 0
+struct Unsoftened {
+    float inv_r3(float r_sq) const { return 1.0f / (r_sq * std::sqrt(r_sq)); }
+};
+
+// Plummer softening: 1 / (|r|^2 + eps^2)^(3/2)
+struct Softened {
+    float eps = 0.05f;
+    float inv_r3(float r_sq) const
+    {
+        const float s = r_sq + eps * eps;
+        return 1.0f / (s * std::sqrt(s));
+    }
+};
+
+
+// ---- laws ------------------------------------------------------------------------
+
+template <class Softening = Unsoftened>
+struct Gravity {
+    using fields = FieldList<fields::Mass>;
+
+    float g = kGravity;
+    Softening softening{};
+
+    template <class P>
+    glm::vec3 pair(const P&, const P& other, const glm::vec3& r, float r_sq) const
+    {
+        return (g * other.mass * softening.inv_r3(r_sq)) * r;
+    }
+};
+
+// like charges repel; acceleration scales with charge-to-mass ratio of `self`
+template <class Softening = Softened>
+struct Coulomb {
+    using fields = FieldList<fields::Mass, fields::Charge>;
+
+    float k = 1.0f;
+    Softening softening{};
+
+    template <class P>
+    glm::vec3 pair(const P& self, const P& other, const glm::vec3& r, float r_sq) const
+    {
+        return (-k * self.charge * other.charge / self.mass * softening.inv_r3(r_sq)) * r;
+    }
+};
+
+// linear drag against a still medium, a = -c v
+struct Drag {
+    using fields = FieldList<>;
+
+    float coefficient = 0.01f;
+
+    template <class P>
+    glm::vec3 body(const P& self, const glm::vec3&) const
+    {
+        return -coefficient * self.vel;
+    }
+};
+
+// fixed point mass at `centre`, e.g. a galaxy halo or a star that is not simulated
+template <class Softening = Softened>
+struct CentralPotential {
+    using fields = FieldList<>;
+
+    glm::vec3 centre{0};
+    float gm = 100.0f * kGravity;
+    Softening softening{};
+
+    template <class P>
+    glm::vec3 body(const P&, const glm::vec3& pos) const
+    {
+        const glm::vec3 r = centre - pos;
+        return (gm * softening.inv_r3(dot(r, r))) * r;
+    }
+};
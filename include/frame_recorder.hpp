@@ -0,0 +1,93 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "opengl_fwd.hpp"
+
+typedef struct __GLsync* GLsync;
+
+
+enum class ImageFormat { Png, Raw };
+
+struct RecorderConfig {
+    std::filesystem::path out_dir;
+    std::uint32_t width;
+    std::uint32_t height;
+    ImageFormat format = ImageFormat::Png;
+    std::uint32_t ring_size = 3;      // PBOs in flight
+    unsigned writer_threads = 2;
+};
+
+
+/**
+ * Renders into an offscreen framebuffer and streams every frame to disk.
+ *
+ * `capture()` only issues glReadPixels into the next pixel buffer of a ring and
+ * fences it; a buffer is mapped once its fence has signalled, normally a couple
+ * of frames later, so the readback never stalls the pipeline. Mapped pixels are
+ * copied out and encoded by writer threads. Frame buffers are recycled, and the
+ * number of frames queued for writing is bounded.
+ */
+class FrameRecorder {
+public:
+    explicit FrameRecorder(const RecorderConfig& config);
+    ~FrameRecorder();
+
+    // makes the offscreen target current for drawing
+    void bind() const;
+    // queues the readback of the frame rendered since `bind()`
+    void capture();
+    // waits for every queued frame to reach the disk
+    void finish();
+
+    // frames on disk, and frames whose write failed (reported on stderr as they happen)
+    std::uint64_t frames_written() const;
+    std::uint64_t frames_failed() const;
+
+    FrameRecorder(const FrameRecorder&)            = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+private:
+    struct Slot {
+        GLuint pbo = 0;
+        const std::uint8_t* mapped = nullptr;
+        GLsync fence = nullptr;
+        std::uint64_t frame = 0;
+    };
+
+    struct Job {
+        std::uint64_t frame;
+        std::vector<std::uint8_t> pixels;
+    };
+
+    void retire(Slot& slot, bool block);
+    void writer_loop();
+
+    RecorderConfig config;
+    std::size_t frame_bytes;
+
+    GLuint fbo = 0;
+    GLuint colour_rb = 0;
+    GLuint depth_rb = 0;
+
+    std::vector<Slot> ring;
+    std::uint32_t head = 0;
+    std::uint64_t next_frame = 0;
+
+    mutable std::mutex mtx;
+    std::condition_variable work_ready;
+    std::condition_variable space_ready;
+    std::deque<Job> queue;
+    std::vector<std::vector<std::uint8_t>> free_buffers;
+    std::size_t in_progress = 0;
+    std::uint64_t written = 0;
+    std::uint64_t failed = 0;
+    bool stopping = false;
+    std::vector<std::thread> writers;
+};
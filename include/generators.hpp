@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+
+struct State;
+
+
+/**
+ * Procedural initial conditions. Every generator appends `count` bodies to the
+ * state in one resize and fills them in parallel; body i of a call draws from
+ * its own `CounterRng` stream, so output depends only on the parameters and
+ * the seed, never on the thread count.
+ *
+ * Masses and velocities are in simulation units, i.e. consistent with kGravity.
+ */
+
+struct BodyStyle {
+    float radius = 0.1f;            // Transform::scale
+    glm::vec3 colour{0.9f, 0.9f, 1.0f};
+    std::uint32_t mesh_id = 0;      // into State::meshes
+};
+
+struct PlummerParams {
+    std::size_t count;
+    float total_mass = 100.0f;
+    float scale_radius = 5.0f;
+    glm::vec3 centre{0};
+    glm::vec3 bulk_vel{0};
+    BodyStyle style{};
+};
+
+struct HernquistParams {
+    std::size_t count;
+    float total_mass = 100.0f;
+    float scale_radius = 5.0f;
+    glm::vec3 centre{0};
+    glm::vec3 bulk_vel{0};
+    BodyStyle style{};
+};
+
+struct DiskGalaxyParams {
+    std::size_t disk_count;
+    std::size_t bulge_count;
+    float disk_mass = 100.0f;
+    float bulge_mass = 30.0f;
+    float scale_length = 8.0f;      // exponential disk R_d
+    float scale_height = 0.5f;      // sech^2 vertical profile z_0
+    float bulge_radius = 1.5f;      // Hernquist a of the bulge
+    float velocity_dispersion = 0.1f; // fraction of the circular speed
+    glm::vec3 centre{0};
+    glm::vec3 normal{0, 0, 1};
+    BodyStyle disk_style{};
+    BodyStyle bulge_style{0.1f, {1.0f, 0.8f, 0.5f}};
+};
+
+struct UniformCubeParams {
+    std::size_t count;
+    float side = 40.0f;
+    float total_mass = 100.0f;
+    float velocity_dispersion = 0.0f; // 0 = cold start
+    glm::vec3 centre{0};
+    BodyStyle style{};
+};
+
+struct PlanetarySystemParams {
+    std::size_t count;
+    std::uint32_t star_id;          // body id of the central light source
+    float inner_radius = 4.0f;
+    float outer_radius = 40.0f;     // semi-major axes are log-uniform in between
+    float min_mass = 1e-4f;
+    float max_mass = 1e-2f;
+    float max_eccentricity = 0.05f;
+    float max_inclination = 0.05f;  // radians, around the z axis plane
+    BodyStyle style{0.2f, {0.4f, 0.7f, 1.0f}};
+};
+
+void generate_plummer(State& state, const PlummerParams& params, std::uint64_t seed);
+void generate_hernquist(State& state, const HernquistParams& params, std::uint64_t seed);
+void generate_disk_galaxy(State& state, const DiskGalaxyParams& params, std::uint64_t seed);
+void generate_uniform_cube(State& state, const UniformCubeParams& params, std::uint64_t seed);
+void generate_planetary_system(State& state, const PlanetarySystemParams& params, std::uint64_t seed);
@@ -0,0 +1,23 @@
+#pragma once
+
+
+/**
+ * Windowless OpenGL 4.5 core context through EGL on the Mesa "surfaceless"
+ * platform, so rendering works on machines without a display server or GPU
+ * (llvmpipe). Rendering has to go to a framebuffer object, there is no default
+ * framebuffer. Loads GL entry points through glad on construction.
+ *
+ * Linux only, the constructor throws elsewhere or when no EGL device is usable.
+ */
+class HeadlessContext {
+public:
+    HeadlessContext();
+    ~HeadlessContext();
+
+    HeadlessContext(const HeadlessContext&)            = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+private:
+    void* display = nullptr;
+    void* context = nullptr;
+};
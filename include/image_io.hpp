@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+
+/**
+ * Write 8-bit RGBA pixels as a PNG. Deflate runs in "stored" mode: files are
+ * about as large as the raw pixels but encoding is a straight copy, which keeps
+ * writer threads ahead of the renderer without pulling in zlib.
+ *
+ * @param flip_y  rows are stored bottom-up (as glReadPixels returns them)
+ * @throws        std::runtime_error if the file cannot be written
+ */
+void write_png(const std::filesystem::path& path,
+               std::uint32_t width,
+               std::uint32_t height,
+               const std::uint8_t* rgba,
+               bool flip_y);
+
+// Headerless top-down RGBA8, `width * height * 4` bytes
+void write_raw_rgba(const std::filesystem::path& path,
+                    std::uint32_t width,
+                    std::uint32_t height,
+                    const std::uint8_t* rgba,
+                    bool flip_y);
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "opengl_fwd.hpp"
+
+struct State;
+struct ShaderProgram;
+
+typedef struct __GLsync* GLsync;
+
+
+struct ClusterConfig {
+    // view frustum split into grid_x * grid_y screen tiles and grid_z exponential depth slices
+    std::uint32_t grid_x = 16;
+    std::uint32_t grid_y = 9;
+    std::uint32_t grid_z = 24;
+    // upper bound on the lights a fragment evaluates; the weakest are dropped past it
+    std::uint32_t max_lights_per_cluster = 64;
+
+    float intensity_per_area = 24.0f; // emitter intensity = this * scale^2
+    float cutoff = 0.01f;             // attenuation at which a light's range ends
+};
+
+struct ClusterStats {
+    std::uint32_t lights = 0;
+    std::uint32_t assignments = 0;  // light-cluster pairs after capping
+    std::uint32_t dropped = 0;      // pairs cut by max_lights_per_cluster
+    std::uint64_t build_ns = 0;
+};
+
+// One light as laid out in the shader storage buffer (std430)
+struct LightData {
+    glm::vec4 pos_range; // world position, w = range
+    glm::vec4 colour;    // rgb colour, w = intensity
+};
+static_assert(sizeof(LightData) == 32);
+
+
+/**
+ * Clustered forward lighting for every `is_light_source` body.
+ *
+ * `prepare()` interpolates emitter positions and assigns each light to the
+ * view-space clusters its range sphere touches. The work is split over the
+ * thread pool, one task per depth slice, so each task owns its clusters and
+ * needs no synchronisation. Results go into a persistently mapped buffer:
+ * lights (binding 1), per-cluster offset and count (binding 2) and the
+ * compacted light index lists (binding 3). The fragment shader finds its
+ * cluster from the window position and depth and only loops over that list.
+ *
+ * Emitters are found by scanning models once as they are added, not every
+ * frame; `State::set_light_source` triggers a full rescan. Like `RenderBatch`, the buffer is a ring of `ring_size` regions, each
+ * fenced by `end_frame()`.
+ */
+class LightClusters {
+public:
+    explicit LightClusters(ClusterConfig config = {}, std::uint32_t ring_size = 3);
+    ~LightClusters();
+
+    // cluster bounds follow the perspective projection used for drawing
+    void set_projection(float fovy, float aspect, float near_plane, float far_plane);
+
+    void prepare(const State& state, float alpha, const glm::mat4& view);
+    // binds the buffers and sets the cluster uniforms of `program`, which must be in use
+    void bind(const ShaderProgram& program) const;
+    // call once the frame's draws are issued
+    void end_frame();
+
+    const ClusterStats& stats() const noexcept { return stats_; }
+    const ClusterConfig& config() const noexcept { return cfg; }
+
+    LightClusters(const LightClusters&)            = delete;
+    LightClusters& operator=(const LightClusters&) = delete;
+
+private:
+    struct Box {
+        glm::vec3 lo, hi;
+    };
+
+    void scan_emitters(const State& state);
+    void reserve(std::size_t region_bytes);
+    void release();
+
+    ClusterConfig cfg;
+    std::uint32_t ring_size;
+    std::size_t ssbo_align = 16;
+
+    float z_near = 0.1f, z_far = 100.0f;
+    std::vector<float> slice_depth;     // grid_z + 1 boundaries
+    std::vector<Box> boxes;             // view-space bounds per cluster
+
+    std::vector<std::uint32_t> emitters; // model indices of light sources
+    std::size_t models_scanned = 0;
+    std::uint64_t light_version = 0;     // State::light_version() at the last full scan
+
+    GLuint buffer = 0;
+    std::byte* mapped = nullptr;
+    std::size_t region_bytes = 0;
+    std::vector<GLsync> fences;
+    std::uint32_t region = 0;
+    // byte offsets and sizes of the three sections in the current region
+    std::size_t clusters_offset = 0, indices_offset = 0;
+    std::size_t lights_bytes = 0, clusters_bytes = 0, indices_bytes = 0;
+
+    // per frame
+    std::vector<glm::vec4> view_lights;     // view-space position, w = range
+    std::vector<float> intensities;
+    std::vector<std::uint32_t> counts;      // [cluster]
+    std::vector<std::uint32_t> scratch;     // [cluster][max_lights_per_cluster]
+    std::vector<std::uint32_t> offsets;     // [cluster]
+    std::vector<std::uint32_t> slice_dropped;
+
+    ClusterStats stats_;
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 #include "opengl_fwd.hpp"
 
 
@@ -20,5 +22,12 @@ struct Mesh {
          const size_t  index_count);
     ~Mesh();
 
+    // owns GL handles: move-only, a moved-from mesh holds zero handles
+    Mesh(Mesh&& other) noexcept;
+    Mesh& operator=(Mesh&& other) noexcept;
+    Mesh(const Mesh&)            = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
     void draw() const;
+    void draw_instanced(std::uint32_t instances) const;
 };
@@ -1,50 +1,17 @@
 #pragma once
 
-#include <memory>
-#include <iterator>
-#include <vector>
+#include <cstdint>
 
 #include "mesh.hpp"
-#include "opengl_fwd.hpp"
 
 
+// Per-body render record. Geometry is shared: many bodies point at the same mesh
 struct Model {
-    std::uint32_t idx;
-    Mesh mesh;
-    bool is_light_source;
-
-    Model(const Vertex* vertices,
-          size_t        vertex_count,
-          const GLuint* indices,
-          size_t        index_count,
-          const std::uint32_t idx,
-          const bool is_light_source)
-        : idx{idx},
-          is_light_source{is_light_source},
-          mesh(vertices, vertex_count, indices, index_count)
-    {}
-
-    void draw() const {
-        mesh.draw();
-    }
-};
-
-
-struct Cube : Model {
-    Cube(std::uint32_t idx) noexcept;
+    std::uint32_t idx;      // body id
+    std::uint32_t mesh_id;  // index into State::meshes
+    bool is_light_source;   // change through State::set_light_source once created
 };
 
-struct Sphere : Model {
-    Sphere(std::uint32_t idx,
-           bool is_light_source,
-           std::vector<Vertex>& vertices,
-           std::vector<GLuint>& indices) noexcept;
-
-    Sphere(const Sphere&) = delete;
-    Sphere& operator=(const Sphere&) = delete;
-
-    Sphere(Sphere&&) noexcept = default;
-    Sphere& operator=(Sphere&&) noexcept = default;
-};
 
-std::unique_ptr<Sphere> create_sphere(std::uint32_t idx, bool is_light_source);
+Mesh create_cube_mesh();
+Mesh create_sphere_mesh();
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+
+
+constexpr std::uint32_t kMortonBits = 10; // per axis -> 30-bit keys
+
+/**
+ * Spread the low 10 bits of `v` so that two zero bits sit between each of them.
+ */
+inline std::uint32_t morton_spread(std::uint32_t v)
+{
+    v &= 0x000003ffu;
+    v = (v | (v << 16)) & 0xff0000ffu;
+    v = (v | (v <<  8)) & 0x0300f00fu;
+    v = (v | (v <<  4)) & 0x030c30c3u;
+    v = (v | (v <<  2)) & 0x09249249u;
+    return v;
+}
+
+inline void quantise(const glm::vec3& pos,
+                     const glm::vec3& lo,
+                     const glm::vec3& inv_extent,
+                     std::uint32_t (&q)[3])
+{
+    constexpr float kCells = static_cast<float>((1u << kMortonBits) - 1);
+
+    for (int a=0; a<3; ++a) {
+        float t = (pos[a] - lo[a]) * inv_extent[a];
+        t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+        q[a] = static_cast<std::uint32_t>(t * kCells);
+    }
+}
+
+/**
+ * Morton (Z-order) key of `pos` quantised inside the box starting at `lo`.
+ *
+ * @param inv_extent  1 / box extent per axis, so that `lo + extent` maps to the last cell.
+ */
+inline std::uint32_t morton_key(const glm::vec3& pos,
+                                const glm::vec3& lo,
+                                const glm::vec3& inv_extent)
+{
+    std::uint32_t q[3];
+    quantise(pos, lo, inv_extent, q);
+    return morton_spread(q[0]) | (morton_spread(q[1]) << 1) | (morton_spread(q[2]) << 2);
+}
+
+/**
+ * Hilbert key of `pos`, same quantisation as `morton_key`.
+ * Unlike Z-order, consecutive keys are always face-adjacent cells, which keeps runs
+ * of bodies spatially tighter at the cost of a few more bit operations.
+ * (Skilling, "Programming the Hilbert curve", 2004)
+ */
+inline std::uint32_t hilbert_key(const glm::vec3& pos,
+                                 const glm::vec3& lo,
+                                 const glm::vec3& inv_extent)
+{
+    std::uint32_t x[3];
+    quantise(pos, lo, inv_extent, x);
+
+    // inverse undo
+    for (std::uint32_t q = 1u << (kMortonBits - 1); q > 1; q >>= 1) {
+        const std::uint32_t p = q - 1;
+        for (int i=0; i<3; ++i) {
+            if (x[i] & q) {
+                x[0] ^= p;
+            } else {
+                const std::uint32_t t = (x[0] ^ x[i]) & p;
+                x[0] ^= t;
+                x[i] ^= t;
+            }
+        }
+    }
+
+    // gray encode
+    x[1] ^= x[0];
+    x[2] ^= x[1];
+    std::uint32_t t = 0;
+    for (std::uint32_t q = 1u << (kMortonBits - 1); q > 1; q >>= 1) {
+        if (x[2] & q)
+            t ^= q - 1;
+    }
+    for (auto& v : x)
+        v ^= t;
+
+    return morton_spread(x[2]) | (morton_spread(x[1]) << 1) | (morton_spread(x[0]) << 2);
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "arena.hpp"
+#include "physics_config.hpp"
+#include "transform.hpp"
+
+struct State;
+
+
+struct OctreeConfig {
+    std::uint32_t leaf_capacity = 16;
+    std::uint32_t max_depth = 20;
+
+    // rebuild triggers, checked after every incremental update against the tree as last built
+    float max_empty_leaf_growth = 0.25f;  // empty leaf fraction now - fraction after the last build
+    float max_node_growth = 2.0f;         // nodes now / nodes after the last build
+    float max_slot_waste = 1.0f;          // abandoned leaf slots / bodies
+    std::uint32_t max_depth_growth = 4;   // deepest leaf now - deepest after the last build
+};
+
+struct OctreeStats {
+    std::uint64_t build_ns = 0;     // last full rebuild
+    std::uint64_t refit_ns = 0;     // last incremental update
+    std::uint32_t reinserted = 0;   // bodies that changed leaf in the last update
+    std::uint32_t rebuilds = 0;
+    std::uint32_t nodes = 0;
+    std::uint32_t max_depth = 0;
+};
+
+
+/**
+ * Octree over body positions, kept up to date incrementally.
+ *
+ * Cells are fixed cubes from the last full build. On update, only bodies that
+ * left their leaf cell are removed and reinserted below the nearest ancestor
+ * that still contains them. Leaves split on overflow. Tight bounds and
+ * monopole moments are then refit bottom-up: leaves in parallel, internal nodes
+ * in reverse creation order. Children are always created after their parent,
+ * so this order is bottom-up. The tree is rebuilt from Morton-sorted bodies
+ * when it is invalidated (bodies added or reordered), when a body leaves the
+ * root, or when a quality metric from `OctreeConfig` degrades.
+ *
+ * One instance lives in `State` and serves every spatial consumer: gravity
+ * (`accel`) walks it directly, and range queries go through a
+ * `SpatialSnapshot` copied from it.
+ */
+class Octree {
+public:
+    static constexpr std::uint32_t kNone = ~0u;
+    static constexpr std::uint32_t kMaxDepth = 24;
+
+    struct Node {
+        glm::vec3 centre;           // cell, fixed until the next rebuild
+        float half;
+        glm::vec3 lo, hi;           // tight bounds of the positions below, refit
+        float reach;                // largest body scale below
+        glm::vec3 com;
+        PhysicsProps aggregate;     // summed law fields, a pseudo-body at `com`
+        std::uint32_t total;        // bodies below
+        std::uint32_t parent;
+        std::uint32_t first_child;  // kNone for leaves, else 8 children in octant order
+        std::uint32_t begin, count, capacity; // leaf slot range
+        std::uint32_t depth;
+    };
+
+    explicit Octree(OctreeConfig config = {});
+
+    // structure no longer matches the bodies (added, removed or permuted)
+    void invalidate() noexcept { built = false; }
+    // positions changed, refit on the next update
+    void mark_moved() noexcept { dirty = true; }
+
+    // rebuilds or refits to the current positions of `state`, no-op when up to date;
+    // transient lists and sort histograms come from `scratch`
+    void update(const State& state, TickArena& scratch);
+
+    const std::vector<Node>& nodes() const noexcept { return tree; }
+    std::span<const std::uint32_t> bodies(const Node& leaf) const noexcept
+    {
+        return {slots.data() + leaf.begin, leaf.count};
+    }
+    const OctreeStats& stats() const noexcept { return stats_; }
+    const OctreeConfig& config() const noexcept { return cfg; }
+
+    // Barnes-Hut acceleration of body `self` under `law` with opening angle `theta`
+    template <class Law>
+    glm::vec3 accel(const Law& law, std::uint32_t self, const Transform* tfs,
+                    const PhysicsProps* props, float theta) const;
+
+private:
+    static constexpr std::size_t kStackSize = 8 * kMaxDepth + 8;
+
+    void rebuild(const State& state, TickArena& scratch);
+    void build_node(std::uint32_t node, std::size_t begin, std::size_t end);
+    std::uint32_t add_children(std::uint32_t node);
+    std::uint32_t alloc_slots(std::uint32_t capacity);
+
+    void remove(std::uint32_t body);
+    void insert(std::uint32_t body, const glm::vec3& pos, std::uint32_t from, const Transform* tfs);
+    void push(std::uint32_t leaf, std::uint32_t body);
+    void split(std::uint32_t leaf, const Transform* tfs);
+    void grow(std::uint32_t leaf);
+
+    void refit(const State& state);
+    std::size_t node_limit() const;
+    float empty_fraction() const;
+    bool degraded(std::size_t num_bodies) const;
+
+    OctreeConfig cfg;
+    bool built = false;
+    bool dirty = false;
+
+    std::vector<Node> tree;
+    std::vector<std::uint32_t> slots;       // leaf body lists, one range per leaf
+    std::vector<std::uint32_t> leaf_of;     // body index -> leaf
+    std::vector<std::uint32_t> slot_of;     // body index -> position in `slots`
+    std::size_t slot_waste = 0;
+
+    std::uint32_t empty_leaves = 0, leaves = 0;
+    std::size_t nodes_at_build = 0;
+    float empty_fraction_at_build = 0.0f;
+    std::uint32_t depth_at_build = 0;
+
+    // scratch kept between updates
+    std::vector<std::uint32_t> keys, keys_tmp, order, order_tmp;
+    std::vector<std::span<const std::uint32_t>> movers; // per update chunk, in tick arena memory
+    std::vector<std::uint32_t> split_scratch;
+
+    OctreeStats stats_;
+};
+
+
+namespace octree_detail
+{
+inline bool inside(const glm::vec3& p, const glm::vec3& lo, const glm::vec3& hi)
+{
+    return p.x >= lo.x && p.y >= lo.y && p.z >= lo.z
+        && p.x <= hi.x && p.y <= hi.y && p.z <= hi.z;
+}
+}
+
+template <class Law>
+glm::vec3 Octree::accel(const Law& law, std::uint32_t self, const Transform* tfs,
+                        const PhysicsProps* props, float theta) const
+{
+    const float theta_sq = theta * theta;
+    const glm::vec3 pos = tfs[self].pos;
+    const PhysicsProps& p = props[self];
+
+    glm::vec3 acc{0};
+    std::uint32_t stack[kStackSize];
+    std::size_t top = 0;
+    stack[top++] = 0;
+
+    while (top) {
+        const Node& node = tree[stack[--top]];
+        if (node.total == 0)
+            continue;
+
+        // a node holding the body itself is never summarised, its aggregate includes it
+        if (!octree_detail::inside(pos, node.lo, node.hi)) {
+            const glm::vec3 r_vec = node.com - pos;
+            const float r_sq = dot(r_vec, r_vec);
+            const glm::vec3 ext = node.hi - node.lo;
+            const float size = std::max(ext.x, std::max(ext.y, ext.z));
+            if (size * size < theta_sq * r_sq) {
+                acc += pair_accel(law, p, node.aggregate, r_vec, r_sq);
+                continue;
+            }
+        }
+
+        if (node.first_child == kNone) {
+            for (const std::uint32_t j : bodies(node)) {
+                if (j == self) continue;
+
+                const glm::vec3 r_vec = tfs[j].pos - pos;
+                acc += pair_accel(law, p, props[j], r_vec, dot(r_vec, r_vec));
+            }
+        } else {
+            for (std::uint32_t k=0; k<8; ++k)
+                stack[top++] = node.first_child + k;
+        }
+    }
+    return acc;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+/**
+ * Non-owning reference to a `void(std::size_t task, unsigned worker)` callable.
+ * Unlike std::function it never allocates, so handing work to the pool is free
+ * of heap traffic. The callable must outlive the `ThreadPool::run` call.
+ */
+class TaskRef {
+public:
+    template <class Fn>
+        requires (!std::is_same_v<std::remove_cvref_t<Fn>, TaskRef>)
+    TaskRef(Fn&& fn) noexcept
+        : obj(const_cast<void*>(static_cast<const void*>(std::addressof(fn)))),
+          call([](void* o, std::size_t task, unsigned worker) {
+              (*static_cast<std::remove_reference_t<Fn>*>(o))(task, worker);
+          })
+    {}
+
+    void operator()(std::size_t task, unsigned worker) const { call(obj, task, worker); }
+
+private:
+    void* obj;
+    void (*call)(void*, std::size_t, unsigned);
+};
+
+
+/**
+ * Small persistent fork-join pool. The calling thread takes part as worker 0,
+ * so `size()` is the total number of threads that can run tasks at once.
+ *
+ * `run` is not reentrant: a call made from inside a task executes serially on
+ * that thread instead of deadlocking the pool. The same happens when another
+ * thread (e.g. rendering while physics ticks) already has a job running.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned num_threads = std::max(1u, std::thread::hardware_concurrency()));
+    ~ThreadPool();
+
+    unsigned size() const noexcept { return static_cast<unsigned>(threads.size()) + 1; }
+
+    // Runs fn(task, worker) for every task in [0, num_tasks), blocks until all finished
+    void run(std::size_t num_tasks, TaskRef fn);
+
+    ThreadPool(const ThreadPool&)            = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+private:
+    void worker_loop(unsigned worker);
+    void drain(unsigned worker);
+
+    std::vector<std::thread> threads;
+
+    std::mutex submit_mtx; // held by the thread whose job occupies the pool
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    const TaskRef* job = nullptr;
+    std::size_t job_tasks = 0;
+    std::size_t next_task = 0;
+    std::size_t finished_tasks = 0;
+    std::uint64_t generation = 0;
+    bool stopping = false;
+};
+
+// Process-wide pool shared by physics, reordering and render preparation
+ThreadPool& default_pool();
+
+
+/**
+ * Splits [0, count) into at most one contiguous chunk per pool thread, each at
+ * least `min_chunk` long, and calls fn(begin, end, worker) for every chunk.
+ */
+template <class Fn>
+void parallel_for(std::size_t count, std::size_t min_chunk, Fn&& fn)
+{
+    if (count == 0)
+        return;
+
+    ThreadPool& pool = default_pool();
+    const std::size_t max_chunks = (count + min_chunk - 1) / std::max<std::size_t>(min_chunk, 1);
+    const std::size_t chunks = std::clamp<std::size_t>(max_chunks, 1, pool.size());
+    if (chunks == 1) {
+        fn(std::size_t{0}, count, 0u);
+        return;
+    }
+
+    const std::size_t step = (count + chunks - 1) / chunks;
+    pool.run(chunks, [&](std::size_t task, unsigned worker) {
+        const std::size_t begin = task * step;
+        const std::size_t end = std::min(count, begin + step);
+        if (begin < end)
+            fn(begin, end, worker);
+    });
+}
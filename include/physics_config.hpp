@@ -0,0 +1,41 @@
+#pragma once
+
+#include <type_traits>
+
+#include "force_laws.hpp"
+
+
+/**
+ * The force law the simulation is compiled with. Laws compose with `+`, e.g.
+ *
+ *   Gravity<Softened>{.softening = {0.1f}} + Drag{0.02f}
+ *   Gravity<>{} + Coulomb<>{.k = 5.0f} + CentralPotential<>{.gm = 500.0f}
+ *   CentralPotential<>{} + Drag{}    // no pair term: bodies do not interact
+ *
+ * and `PhysicsProps` holds exactly the per-body fields the composition reads.
+ * tests/force_law_check.hpp builds the physics sources with each of these.
+ */
+#if defined(SPACESIM_FORCE_LAW_CHECK)
+#include "force_law_check.hpp"
+#else
+inline constexpr auto kForceLaw = Gravity<Unsoftened>{};
+#endif
+
+using ForceLaw = std::remove_cv_t<decltype(kForceLaw)>;
+using PhysicsProps = BodyProps<ForceLaw::fields>;
+
+
+// builds props from the full set of inputs, dropping whatever the law does not store
+template <class Props = PhysicsProps>
+Props make_props(const glm::vec3& vel, float mass, float charge = 0.0f)
+{
+    Props p{};
+    p.vel = vel;
+    if constexpr (has_field_v<Props, fields::Mass>)
+        p.mass = mass;
+    if constexpr (has_field_v<Props, fields::Charge>)
+        p.charge = charge;
+    (void)mass;
+    (void)charge;
+    return p;
+}
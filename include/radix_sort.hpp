@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+
+/**
+ * Stable parallel LSD radix sort of (key, value) pairs by key, 8 bits per pass.
+ * Passes over digits that every key shares are skipped, so 30-bit curve keys
+ * cost at most four passes and often fewer.
+ *
+ * `keys_tmp`/`values_tmp` are scratch buffers, resized as needed and reusable
+ * across calls to avoid reallocating. Per-thread histograms come from `scratch`.
+ */
+void radix_sort_pairs(std::vector<std::uint32_t>& keys,
+                      std::vector<std::uint32_t>& values,
+                      std::vector<std::uint32_t>& keys_tmp,
+                      std::vector<std::uint32_t>& values_tmp,
+                      std::pmr::memory_resource* scratch = std::pmr::get_default_resource());
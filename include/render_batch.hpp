@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "arena.hpp"
+#include "mesh.hpp"
+#include "opengl_fwd.hpp"
+
+struct State;
+
+typedef struct __GLsync* GLsync;
+
+
+// One instance as laid out in the shader storage buffer (std430)
+struct InstanceData {
+    glm::mat4 model;
+    glm::vec4 colour; // rgb albedo, w = 1 when lit, 0 for light sources
+};
+static_assert(sizeof(InstanceData) == 80);
+
+
+/**
+ * Prepares every visible body for instanced drawing.
+ *
+ * `prepare()` culls bodies against the view frustum, interpolates previous and
+ * current transforms and writes model matrices straight into a persistently
+ * mapped storage buffer, grouped by mesh. Work is split in fixed chunks over the
+ * thread pool: a first pass culls and counts, a prefix sum places each chunk,
+ * and a second pass writes 4 bodies at a time with SSE. Rotations are blended
+ * with normalised lerp instead of slerp, and groups whose rotations are all the
+ * identity skip the quaternion maths.
+ *
+ * The buffer is split into `ring_size` regions fenced per frame, so the CPU
+ * never writes a region the GPU may still be reading.
+ */
+class RenderBatch {
+public:
+    explicit RenderBatch(std::uint32_t ring_size = 3);
+    ~RenderBatch();
+
+    void prepare(const State& state, float alpha, const glm::mat4& vp);
+    // instanced draw per mesh, instances are bound to SSBO binding 0
+    void draw(const ObjectPool<Mesh>& meshes);
+
+    std::size_t visible() const noexcept { return num_visible; }
+    std::uint64_t prepare_ns() const noexcept { return last_prepare_ns; }
+
+    RenderBatch(const RenderBatch&)            = delete;
+    RenderBatch& operator=(const RenderBatch&) = delete;
+
+private:
+    void reserve(std::size_t region_bytes);
+    void release();
+
+    std::uint32_t ring_size;
+    std::size_t ssbo_align = 16;
+
+    GLuint buffer = 0;
+    std::byte* mapped = nullptr;
+    std::size_t region_bytes = 0;
+    std::vector<GLsync> fences;
+    std::uint32_t region = 0;
+
+    // per frame: model indices grouped by mesh within each chunk, and the counts
+    std::vector<std::uint32_t> culled;
+    std::vector<std::uint32_t> visible_models;
+    std::vector<std::uint32_t> chunk_counts;    // [chunk][mesh]
+    std::vector<std::uint32_t> chunk_starts;    // [chunk][mesh]
+    std::vector<std::size_t> mesh_offsets;      // byte offset of each mesh group
+    std::vector<std::uint32_t> mesh_counts;
+
+    std::size_t num_visible = 0;
+    std::uint64_t last_prepare_ns = 0;
+};
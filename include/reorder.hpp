@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "physics_config.hpp"
+#include "transform.hpp"
+
+struct State;
+
+
+enum class SpaceCurve { Morton, Hilbert };
+
+struct ReorderConfig {
+    SpaceCurve curve = SpaceCurve::Hilbert;
+    std::uint32_t interval_ticks = 0; // 0 disables periodic reordering
+};
+
+
+/**
+ * Sorts the bodies of a `State` along a space-filling curve so that bodies close
+ * in space are close in memory. Every per-body array is permuted together and
+ * the id <-> index tables are rebuilt, so anything holding a body id stays valid.
+ *
+ * Scratch buffers are kept between calls.
+ */
+class BodyReorderer {
+public:
+    void apply(State& state, SpaceCurve curve);
+
+private:
+    template <class T>
+    void permute(std::vector<T>& data, std::vector<T>& scratch) const;
+
+    std::vector<std::uint32_t> keys, keys_tmp;
+    std::vector<std::uint32_t> order, order_tmp; // new index -> old index
+
+    std::vector<Transform> tf_scratch;
+    std::vector<PhysicsProps> props_scratch;
+    std::vector<std::uint32_t> id_scratch;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+
+
+inline std::uint64_t mix64(std::uint64_t x)
+{
+    // splitmix64 finaliser
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27; x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * Counter-based generator: draw n of stream s is a pure function of (seed, s, n).
+ * Giving every body its own stream makes generated scenes identical no matter
+ * how the work is split between threads.
+ */
+struct CounterRng {
+    std::uint64_t key;
+    std::uint64_t counter = 0;
+
+    CounterRng(std::uint64_t seed, std::uint64_t stream)
+        : key(mix64(seed ^ mix64(stream + 0x9e3779b97f4a7c15ull)))
+    {}
+
+    std::uint64_t next_u64() { return mix64(key + (++counter) * 0x9e3779b97f4a7c15ull); }
+
+    // [0, 1)
+    float uniform() { return static_cast<float>(next_u64() >> 40) * 0x1.0p-24f; }
+    // (0, 1), safe to take the log of; 23 bits keep the +0.5 exact, with 24 the top value rounds to 1
+    float uniform_open() { return (static_cast<float>(next_u64() >> 41) + 0.5f) * 0x1.0p-23f; }
+    float uniform(float lo, float hi) { return lo + (hi - lo) * uniform(); }
+
+    float normal()
+    {
+        constexpr float two_pi = 6.28318530717958647692f;
+        return std::sqrt(-2.0f * std::log(uniform_open())) * std::cos(two_pi * uniform());
+    }
+
+    glm::vec3 unit_vector()
+    {
+        constexpr float two_pi = 6.28318530717958647692f;
+        const float z = uniform(-1.0f, 1.0f);
+        const float phi = two_pi * uniform();
+        const float s = std::sqrt(1.0f - z * z);
+        return {s * std::cos(phi), s * std::sin(phi), z};
+    }
+};
@@ -1,36 +1,46 @@
 #pragma once
 
-#include <array>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <format>
+#include <vector>
 
 #include <glm/fwd.hpp>
 
 #include "opengl_fwd.hpp"
 
-constexpr auto kNumUniforms = 6;
-static const std::string uniform_names[kNumUniforms] = {"u_model", "u_vp", "u_enable_light", "u_light_pos", "u_view_pos", "u_albedo"};
+// uniforms each program looks up at link time
+static const std::string uniform_names[] = {
+    "u_vp", "u_view_pos", "u_cluster_grid", "u_cluster_tile", "u_cluster_depth"
+};
+static const std::string trail_uniform_names[] = {
+    "u_vp", "u_trail_newest", "u_trail_slots", "u_trail_samples", "u_trail_stride"
+};
 
 
 struct ShaderProgram {
     GLuint id{};
 
-    std::array<GLint, kNumUniforms> uniforms{};
+    std::span<const std::string> names;
+    std::vector<GLint> uniforms;
 
-    explicit ShaderProgram(GLuint prog_id);
+    ShaderProgram(GLuint prog_id, std::span<const std::string> names);
     ~ShaderProgram();
 
     void set_mat4(std::string_view u_name, const glm::mat4& mat) const;
+    void set_vec2(std::string_view u_name, const glm::vec2& vec) const;
     void set_vec3(std::string_view u_name, const glm::vec3& vec) const;
-    void set_bool(std::string_view u_name, const bool b) const;
+    void set_vec4(std::string_view u_name, const glm::vec4& vec) const;
+    void set_uvec3(std::string_view u_name, const glm::uvec3& vec) const;
+    void set_uint(std::string_view u_name, std::uint32_t u) const;
 
 private:
     inline GLint uniform_location(std::string_view name) const
     {
-        for (std::size_t i=0; i<kNumUniforms; ++i) {
-            if (uniform_names[i] == name)
+        for (std::size_t i=0; i<names.size(); ++i) {
+            if (names[i] == name)
                 return uniforms[i];
         }
 
@@ -39,4 +49,4 @@ private:
 };
 
 GLuint compile_shader(GLenum type, std::string_view src);
-ShaderProgram make_program(GLuint vs, GLuint fs);
+ShaderProgram make_program(GLuint vs, GLuint fs, std::span<const std::string> names = uniform_names);
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct State;
+
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 dir; // need not be normalised, `t` is in units of its length
+};
+
+struct RayHit {
+    std::uint32_t id; // body id
+    float t;
+};
+
+struct Neighbour {
+    std::uint32_t id; // body id, kNoBody for unfilled slots
+    float dist_sq;
+};
+
+constexpr std::uint32_t kNoBody = std::numeric_limits<std::uint32_t>::max();
+
+
+/**
+ * Immutable copy of body positions and radii (`Transform::scale`) with a
+ * bounding volume hierarchy, taken from the state's octree at one tick.
+ *
+ * Bodies are stored in octree depth-first order, so every node covers a
+ * contiguous range and fully contained nodes are counted without visiting their
+ * bodies. Node boxes enclose whole spheres. Results refer to stable body ids.
+ *
+ * All queries are const and can run on any thread while the simulation goes
+ * on; the batched forms split their queries across the thread pool.
+ */
+class SpatialSnapshot {
+public:
+    struct Node {
+        glm::vec3 lo;
+        std::uint32_t begin;        // body range
+        glm::vec3 hi;
+        std::uint32_t end;
+        std::uint32_t first_child;  // children are contiguous
+        std::uint32_t num_children; // 0 for leaves
+    };
+
+    // snapshot of the current bodies, brings the state's octree up to date first
+    static std::shared_ptr<const SpatialSnapshot> capture(State& state, std::uint64_t tick);
+
+    std::size_t size() const noexcept { return ids.size(); }
+    std::uint64_t tick() const noexcept { return taken_at; }
+
+    // nearest sphere hit along the ray
+    std::optional<RayHit> raycast(const Ray& ray, float max_t = std::numeric_limits<float>::max()) const;
+    // up to k nearest body centres to `p`, closest first, written to `out[0, k)`; returns how many
+    std::size_t nearest(const glm::vec3& p, std::span<Neighbour> out) const;
+    // ids of bodies whose centre lies within `radius` of `c`, appended to `out`
+    void within_radius(const glm::vec3& c, float radius, std::vector<std::uint32_t>& out) const;
+    std::size_t count_within_radius(const glm::vec3& c, float radius) const;
+    std::size_t count_in_box(const glm::vec3& lo, const glm::vec3& hi) const;
+
+    void raycast(std::span<const Ray> rays, std::span<std::optional<RayHit>> hits) const;
+    // row q of `out` (k entries) holds the neighbours of points[q]
+    void nearest(std::span<const glm::vec3> points, std::size_t k, std::span<Neighbour> out) const;
+    void count_within_radius(std::span<const glm::vec3> centres, float radius, std::span<std::uint32_t> counts) const;
+
+private:
+    std::vector<Node> nodes;
+    std::vector<glm::vec4> spheres; // xyz centre, w radius
+    std::vector<std::uint32_t> ids;
+    std::uint64_t taken_at = 0;
+};
+
+
+/**
+ * Latest published snapshot. The simulation publishes after ticking, readers
+ * take a reference and query it for as long as they like; a snapshot lives
+ * until its last reader drops it.
+ */
+class SpatialQueries {
+public:
+    void publish(State& state, std::uint64_t tick);
+    std::shared_ptr<const SpatialSnapshot> snapshot() const;
+
+private:
+    mutable std::mutex mtx;
+    std::shared_ptr<const SpatialSnapshot> current;
+};
@@ -5,17 +5,16 @@
 
 #include <glm/vec3.hpp>
 
+#include "arena.hpp"
+#include "domain.hpp"
 #include "models.hpp"
+#include "octree.hpp"
+#include "physics_config.hpp"
+#include "reorder.hpp"
 #include "transform.hpp"
 #include "opengl_fwd.hpp"
 
 
-struct PhysicsProps {
-    glm::vec3 vel;
-    float mass;
-};
-
-
 struct State {
     // possible future considerations,
     // combine curr and prev Transforms into single struct
@@ -23,19 +22,66 @@ struct State {
     std::vector<Transform> prev_tfs; // used for alpha-interpolation rendering
 
     std::vector<PhysicsProps> props;
-    std::vector<std::unique_ptr<Model>> models;
+
+    // stable body ids: `ids[index]` and its inverse `index_of[id]`.
+    // indices change whenever bodies are reordered, ids never do
+    std::vector<std::uint32_t> ids;
+    std::vector<std::uint32_t> index_of;
+
+    std::vector<glm::vec3> albedo; // indexed by body id
+
+    ObjectPool<Mesh> meshes;
+    ObjectPool<Model> models; // Model::idx is a body id
+
+    // per-tick scratch for transient structures, rewound at the start of every tick;
+    // also backs spatial index updates made between ticks
+    TickArena arena;
+
+    ReorderConfig reorder_config;
+
+    // Barnes-Hut opening angle for in-process gravity over `octree`, 0 for the exact pair sum
+    float opening_angle = 0.0f;
+
+    // multi-process mode, see domain.hpp; null when ticking in-process
+    std::unique_ptr<DomainDecomposition> domains;
 
     inline void swap() { prev_tfs = transforms; }
 
-    State() = default;
-    ~State() = default;
+    State();
+    ~State();
 
     void tick(float dt);
+    void enable_domains(DomainConfig config);
+
+    // appends a body and returns its id
+    std::uint32_t add_body(const Transform& tf, const PhysicsProps& p, const glm::vec3& colour);
+    // appends `count` uninitialised bodies, each with a model using `mesh_id`,
+    // and returns the index of the first; ids are assigned consecutively
+    std::size_t append_bodies(std::size_t count, std::uint32_t mesh_id);
+    // sorts bodies along `curve` for memory locality, ids are preserved
+    void reorder(SpaceCurve curve);
+
+    // shared spatial index, brought up to date with the current positions on access
+    const Octree& spatial_index();
+
+    // flags or unflags `models[model]` as a light source after it was created
+    void set_light_source(std::size_t model, bool on);
+    // changes on every `set_light_source`, so renderers know to rescan emitters
+    std::uint64_t light_version() const noexcept { return light_changes; }
 
     // no copy allowed
     State(const State&)            = delete;
     State& operator=(const State&) = delete;
 
-    State(State&&) noexcept            = default;
-    State& operator=(State&&) noexcept = default;
+    State(State&&) noexcept;
+    State& operator=(State&&) noexcept;
+
+private:
+    void tick_direct(float dt);
+
+    BodyReorderer reorderer;
+    std::uint32_t ticks_since_reorder = 0;
+    std::uint64_t light_changes = 0;
+
+    Octree octree;
 };
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include "opengl_fwd.hpp"
+#include "shaders.hpp"
+
+struct State;
+
+typedef struct __GLsync* GLsync;
+
+
+struct TrailConfig {
+    std::uint32_t length = 128;        // samples drawn per trail
+    std::uint32_t interval_ticks = 4;  // ticks between samples
+};
+
+// One sample as laid out in the shader storage buffer (std430)
+struct TrailSample {
+    glm::vec3 pos;
+    std::uint32_t colour; // RGBA8, unpacked in the shader
+};
+static_assert(sizeof(TrailSample) == 16);
+
+
+/**
+ * Orbit trails kept on the GPU.
+ *
+ * Samples live in a persistently mapped ring of slots, one slot per sample and
+ * one entry per body id in each slot. A sample writes only the newest slot, so
+ * upload costs O(bodies) however long the trails are. Drawing is one instanced
+ * line strip per body. The vertex shader walks back from the newest slot
+ * modulo the ring size and fades with age.
+ *
+ * The ring has a few more slots than are drawn. A slot is only rewritten once
+ * the draws that could still read it have passed their fence. Adding bodies
+ * clears the history.
+ */
+class OrbitTrails {
+public:
+    explicit OrbitTrails(TrailConfig config = {});
+    ~OrbitTrails();
+
+    // call after every tick, samples every `interval_ticks`
+    void record(const State& state);
+    void draw(const glm::mat4& vp);
+
+    std::size_t memory_bytes() const noexcept { return slots * stride * sizeof(TrailSample); }
+    std::size_t bodies() const noexcept { return num_bodies; }
+    const TrailConfig& config() const noexcept { return cfg; }
+
+    OrbitTrails(const OrbitTrails&)            = delete;
+    OrbitTrails& operator=(const OrbitTrails&) = delete;
+
+private:
+    void resize(std::size_t bodies);
+    void release();
+    void retire_fences(std::uint64_t up_to, bool all);
+
+    TrailConfig cfg;
+    ShaderProgram program;
+
+    std::uint32_t slots;               // length + slack
+    std::size_t stride = 0;            // allocated entries per slot
+    std::size_t num_bodies = 0;
+
+    GLuint vao = 0;                    // empty, positions come from the buffer
+    GLuint buffer = 0;
+    TrailSample* mapped = nullptr;
+
+    std::uint64_t written = 0;         // samples since the last reset
+    std::uint32_t ticks_since_sample = 0;
+
+    // draws not yet known complete, with the sample count they saw
+    std::deque<std::pair<GLsync, std::uint64_t>> in_flight;
+};
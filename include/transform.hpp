@@ -12,6 +12,9 @@ struct Transform {
     glm::mat4 to_model_mat4() const;
 };
 
+// normalised lerp along the shorter arc, close to slerp for the small per-tick rotations
+glm::quat nlerp(const glm::quat& a, const glm::quat& b, float alpha);
+
 Transform interpolate(const Transform& a,
                       const Transform& b,
                       float alpha);
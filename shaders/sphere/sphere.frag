@@ -1,43 +1,96 @@
-#version 460 core
+#version 450 core
 
 in VS_OUT {
     vec3 frag_pos;
     vec3 normal;
+    flat vec3 albedo;
+    flat uint lit;
 } fs_in;
 
 out vec4 frag_color;
 
-uniform bool u_enable_light;
-uniform vec3 u_light_pos; // point light in world space
+struct Light {
+    vec4 pos_range; // world position, w = range
+    vec4 colour;    // rgb colour, w = intensity
+};
+
+// written by LightClusters
+layout(std430, binding = 1) readonly buffer Lights {
+    Light lights[];
+};
+layout(std430, binding = 2) readonly buffer Clusters {
+    uvec2 clusters[]; // first index, count
+};
+layout(std430, binding = 3) readonly buffer LightIndices {
+    uint light_indices[];
+};
+
 uniform vec3 u_view_pos; // camera position
-uniform vec3 u_albedo; // base colour
+
+uniform uvec3 u_cluster_grid;  // tiles x, tiles y, depth slices
+uniform vec2 u_cluster_tile;   // tiles per pixel
+uniform vec4 u_cluster_depth;  // near, far, slice = log(depth) * z + w
 
 // tweakables
 const float ambient_strength = 0.10;
 const float spec_strength    = 0.30;
 const float shininess        = 32.0;     // bigger = tighter hotspot
-  
+
+uint cluster_index()
+{
+    // linear view depth back from the window depth
+    float n = u_cluster_depth.x, f = u_cluster_depth.y;
+    float z_ndc = gl_FragCoord.z * 2.0 - 1.0;
+    float depth = 2.0 * n * f / (f + n - z_ndc * (f - n));
+
+    float slice = floor(log(depth) * u_cluster_depth.z + u_cluster_depth.w);
+    uint z = uint(clamp(slice, 0.0, float(u_cluster_grid.z - 1u)));
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * u_cluster_tile), u_cluster_grid.xy - 1u);
+    return (z * u_cluster_grid.y + tile.y) * u_cluster_grid.x + tile.x;
+}
+
+// inverse square, windowed to reach zero at the light's range
+float attenuation(float dist, float range, float intensity)
+{
+    float x = dist / range;
+    float window = clamp(1.0 - x * x * x * x, 0.0, 1.0);
+    return intensity * window * window / (dist * dist + 1.0);
+}
+
 void main()
 {
-    if (!u_enable_light) {
-        frag_color = vec4(u_albedo, 1.0);
+    vec3 albedo = fs_in.albedo;
+    if (fs_in.lit == 0u) {
+        frag_color = vec4(albedo, 1.0);
         return;
     }
     // Surface data
     vec3 N = normalize(fs_in.normal);
     vec3 V = normalize(u_view_pos - fs_in.frag_pos);
 
-    // Light contribution
-    vec3 L = normalize(u_light_pos - fs_in.frag_pos);
-    float diff = max(dot(N, L), 0.0);
+    vec3 colour = ambient_strength * albedo;
+
+    // only the lights whose range touches this fragment's cluster
+    uvec2 cluster = clusters[cluster_index()];
+    for (uint k = 0u; k < cluster.y; ++k) {
+        Light light = lights[light_indices[cluster.x + k]];
 
-    // Blinn–Phong specular
-    vec3 H = normalize(L + V);
-    float spec = pow(max(dot(N, H), 0.0), shininess);
+        vec3 to_light = light.pos_range.xyz - fs_in.frag_pos;
+        float dist = length(to_light);
+        float att = attenuation(dist, light.pos_range.w, light.colour.w);
+        if (att <= 0.0)
+            continue;
 
-    vec3 ambient  = ambient_strength * u_albedo;
-    vec3 diffuse  = diff             * u_albedo;
-    vec3 specular = spec_strength    * spec * vec3(1.0); // white highlights
+        // Light contribution
+        vec3 L = to_light / dist;
+        float diff = max(dot(N, L), 0.0);
+
+        // Blinn–Phong specular
+        vec3 H = normalize(L + V);
+        float spec = pow(max(dot(N, H), 0.0), shininess);
+
+        colour += att * light.colour.rgb * (diff * albedo + spec_strength * spec);
+    }
 
-    frag_color = vec4(ambient + diffuse + specular, 1.0);
-}
\ No newline at end of file
+    frag_color = vec4(colour, 1.0);
+}
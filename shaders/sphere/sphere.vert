@@ -1,24 +1,39 @@
-#version 460 core
+#version 450 core
 
 layout(location = 0) in vec3 a_pos;      // vertex position
 layout(location = 1) in vec3 a_normal;   // vertex normal (from your mesh)
 
+struct Instance {
+    mat4 model;
+    vec4 colour; // rgb albedo, w = 1 when lit
+};
+
+// written by RenderBatch, one entry per visible body of the mesh being drawn
+layout(std430, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
 out VS_OUT {
     vec3 frag_pos;
     vec3 normal;
+    flat vec3 albedo;
+    flat uint lit;
 } vs_out;
 
-uniform mat4 u_model;
 uniform mat4 u_vp;
 
 void main()
 {
+    Instance inst = instances[gl_InstanceID];
+
     // World-space position
-    vec4 world_pos   = u_model * vec4(a_pos, 1.0);
+    vec4 world_pos   = inst.model * vec4(a_pos, 1.0);
     vs_out.frag_pos  = world_pos.xyz;
 
     // normal can be simply applied since scale is uniform across x/y/z
-    vs_out.normal    = mat3(u_model) * a_normal;
+    vs_out.normal    = mat3(inst.model) * a_normal;
+    vs_out.albedo    = inst.colour.rgb;
+    vs_out.lit       = inst.colour.w > 0.5 ? 1u : 0u;
 
     gl_Position = u_vp * world_pos;
-}
\ No newline at end of file
+}
@@ -0,0 +1,12 @@
+#version 450 core
+
+in VS_OUT {
+    vec4 colour;
+} fs_in;
+
+out vec4 frag_color;
+
+void main()
+{
+    frag_color = fs_in.colour;
+}
@@ -0,0 +1,34 @@
+#version 450 core
+
+struct Sample {
+    vec3 pos;
+    uint colour; // RGBA8
+};
+
+// written by OrbitTrails, [slot][body id]
+layout(std430, binding = 4) readonly buffer Trails {
+    Sample samples[];
+};
+
+out VS_OUT {
+    vec4 colour;
+} vs_out;
+
+uniform mat4 u_vp;
+uniform uint u_trail_newest;  // slot of the latest sample
+uniform uint u_trail_slots;   // ring size
+uniform uint u_trail_samples; // vertices per strip
+uniform uint u_trail_stride;  // entries per slot
+
+void main()
+{
+    // one strip per body (instance), one vertex per sample going back in time
+    uint age = uint(gl_VertexID);
+    uint slot = (u_trail_newest + u_trail_slots - age) % u_trail_slots;
+    Sample s = samples[slot * u_trail_stride + uint(gl_InstanceID)];
+
+    float fade = 1.0 - float(age) / float(u_trail_samples);
+    vs_out.colour = vec4(unpackUnorm4x8(s.colour).rgb, 0.6 * fade * fade);
+
+    gl_Position = u_vp * vec4(s.pos, 1.0);
+}
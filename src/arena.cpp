@@ -0,0 +1,128 @@
+#include "arena.hpp"
+
+#include <algorithm>
+
+#include "parallel.hpp"
+
+
+namespace
+{
+constexpr std::size_t kBlockAlign = 64;
+constexpr std::size_t kHeaderBytes = kBlockAlign; // header padded so data stays 64-aligned
+}
+
+MonotonicArena::MonotonicArena(std::size_t block_bytes) noexcept
+    : block_bytes(block_bytes)
+{}
+
+MonotonicArena::~MonotonicArena()
+{
+    release();
+}
+
+MonotonicArena::MonotonicArena(MonotonicArena&& other) noexcept
+    : block_bytes(other.block_bytes),
+      head(std::exchange(other.head, nullptr)),
+      current(std::exchange(other.current, nullptr)),
+      offset(std::exchange(other.offset, 0)),
+      used_before(std::exchange(other.used_before, 0)),
+      reserved(std::exchange(other.reserved, 0))
+{}
+
+MonotonicArena& MonotonicArena::operator=(MonotonicArena&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        block_bytes = other.block_bytes;
+        head        = std::exchange(other.head, nullptr);
+        current     = std::exchange(other.current, nullptr);
+        offset      = std::exchange(other.offset, 0);
+        used_before = std::exchange(other.used_before, 0);
+        reserved    = std::exchange(other.reserved, 0);
+    }
+    return *this;
+}
+
+void MonotonicArena::reset() noexcept
+{
+    current = head;
+    offset = 0;
+    used_before = 0;
+}
+
+std::byte* MonotonicArena::block_data(Block* b) const noexcept
+{
+    return reinterpret_cast<std::byte*>(b) + kHeaderBytes;
+}
+
+MonotonicArena::Block* MonotonicArena::new_block(std::size_t min_bytes)
+{
+    const std::size_t size = std::max(block_bytes, min_bytes);
+    void* mem = ::operator new(kHeaderBytes + size, std::align_val_t{kBlockAlign});
+    reserved += size;
+    return ::new (mem) Block{nullptr, size};
+}
+
+void* MonotonicArena::do_allocate(std::size_t bytes, std::size_t align)
+{
+    const std::size_t worst_case = bytes + (align > kBlockAlign ? align : 0);
+
+    for (;;) {
+        if (current) {
+            const auto base = reinterpret_cast<std::uintptr_t>(block_data(current));
+            const std::uintptr_t aligned = (base + offset + align - 1) & ~(std::uintptr_t{align} - 1);
+            const std::size_t end = (aligned - base) + bytes;
+            if (end <= current->size) {
+                offset = end;
+                return reinterpret_cast<void*>(aligned);
+            }
+        }
+
+        // move on to the next retained block that can hold the request, or grow the chain
+        Block* next = current ? current->next : head;
+        if (next && next->size < worst_case) {
+            Block* bigger = new_block(worst_case);
+            bigger->next = next->next;
+            if (current) current->next = bigger; else head = bigger;
+            reserved -= next->size;
+            ::operator delete(next, std::align_val_t{kBlockAlign});
+            next = bigger;
+        } else if (!next) {
+            next = new_block(worst_case);
+            if (current) current->next = next; else head = next;
+        }
+
+        if (current)
+            used_before += offset;
+        current = next;
+        offset = 0;
+    }
+}
+
+void MonotonicArena::release() noexcept
+{
+    Block* b = head;
+    while (b) {
+        Block* next = b->next;
+        ::operator delete(b, std::align_val_t{kBlockAlign});
+        b = next;
+    }
+    head = current = nullptr;
+    offset = used_before = reserved = 0;
+}
+
+
+TickArena::TickArena()
+{
+    const unsigned workers = default_pool().size();
+    locals.reserve(workers);
+    for (unsigned w=0; w<workers; ++w)
+        locals.emplace_back();
+}
+
+void TickArena::reset() noexcept
+{
+    main.reset();
+    for (auto& arena : locals)
+        arena.reset();
+}
@@ -0,0 +1,551 @@
+#include "domain.hpp"
+
+#include <stdexcept>
+
+#include "state.hpp"
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <format>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <glm/glm.hpp>
+
+#include "morton.hpp"
+#include "parallel.hpp"
+#include "radix_sort.hpp"
+
+
+enum : std::uint32_t { kCmdTick = 0, kCmdQuit = 1 };
+
+struct SharedHeader {
+    pthread_barrier_t barrier;
+    std::uint32_t command;
+    float dt;
+    float opening_angle;
+    std::uint32_t num_bodies;
+    std::uint32_t num_domains;
+};
+
+namespace
+{
+constexpr std::uint32_t kUnassigned = std::numeric_limits<std::uint32_t>::max();
+constexpr std::size_t kShmAlign = 64;
+constexpr std::size_t kMinChunk = 1 << 14;
+
+// monopole + bounds of one domain, the only data other domains see when it is far away.
+// `aggregate` is a pseudo-body at `com` holding the summed fields of the force law
+struct DomainSummary {
+    glm::vec3 com;
+    PhysicsProps aggregate;
+    glm::vec3 lo;
+    glm::vec3 hi;
+    std::uint32_t begin, end;   // slot range owned this tick
+    std::uint64_t work_ns;
+};
+
+struct SharedView {
+    SharedHeader* hdr;
+    DomainSummary* domains;
+    glm::vec3* pos;
+    glm::vec3* next_pos;
+    PhysicsProps* props;
+};
+
+constexpr std::size_t align_up(std::size_t v) { return (v + kShmAlign - 1) & ~(kShmAlign - 1); }
+
+struct ShmLayout {
+    std::size_t domains, pos, next_pos, props, total;
+};
+
+ShmLayout shm_layout(std::size_t num_bodies, std::size_t num_domains)
+{
+    ShmLayout l{};
+    l.domains  = align_up(sizeof(SharedHeader));
+    l.pos      = align_up(l.domains  + num_domains * sizeof(DomainSummary));
+    l.next_pos = align_up(l.pos      + num_bodies  * sizeof(glm::vec3));
+    l.props    = align_up(l.next_pos + num_bodies  * sizeof(glm::vec3));
+    l.total    = align_up(l.props    + num_bodies  * sizeof(PhysicsProps));
+    return l;
+}
+
+SharedView view_of(SharedHeader* hdr)
+{
+    const ShmLayout l = shm_layout(hdr->num_bodies, hdr->num_domains);
+    auto* base = reinterpret_cast<std::byte*>(hdr);
+    return SharedView{
+        hdr,
+        reinterpret_cast<DomainSummary*>(base + l.domains),
+        reinterpret_cast<glm::vec3*>(base + l.pos),
+        reinterpret_cast<glm::vec3*>(base + l.next_pos),
+        reinterpret_cast<PhysicsProps*>(base + l.props),
+    };
+}
+
+void barrier_wait(SharedHeader* hdr)
+{
+    pthread_barrier_wait(&hdr->barrier);
+}
+
+void summarise(const SharedView& v, std::uint32_t d)
+{
+    DomainSummary& s = v.domains[d];
+    glm::vec3 weighted{0};
+    glm::vec3 lo{std::numeric_limits<float>::max()};
+    glm::vec3 hi{std::numeric_limits<float>::lowest()};
+    float mass = 0.0f;
+
+    if (s.begin < s.end) {
+        s.aggregate = v.props[s.begin];
+        s.aggregate.vel = glm::vec3{0};
+    }
+    for (std::uint32_t i=s.begin; i<s.end; ++i) {
+        if (i != s.begin)
+            s.aggregate.accumulate(v.props[i]);
+        weighted += mass_of(v.props[i]) * v.pos[i];
+        mass += mass_of(v.props[i]);
+        lo = glm::min(lo, v.pos[i]);
+        hi = glm::max(hi, v.pos[i]);
+    }
+    s.com  = mass > 0.0f ? weighted / mass : glm::vec3{0};
+    s.lo   = lo;
+    s.hi   = hi;
+}
+
+// Domain `d` integrates its own slots, reading everyone's positions and writing next_pos
+void integrate(const SharedView& v, std::uint32_t d)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    const float dt = v.hdr->dt;
+    const float theta_sq = v.hdr->opening_angle * v.hdr->opening_angle;
+    const DomainSummary& own = v.domains[d];
+
+    for (std::uint32_t i=own.begin; i<own.end; ++i) {
+        const glm::vec3 p = v.pos[i];
+        const PhysicsProps& self = v.props[i];
+        glm::vec3 acc = body_accel(kForceLaw, self, p);
+        if constexpr (!HasPair<ForceLaw, PhysicsProps>) {
+            v.props[i].vel += acc * dt;
+            v.next_pos[i] = p + v.props[i].vel * dt;
+            continue;
+        }
+
+        for (std::uint32_t e=0; e<v.hdr->num_domains; ++e) {
+            const DomainSummary& other = v.domains[e];
+            if (other.begin == other.end)
+                continue;
+
+            if (e != d && theta_sq > 0.0f) {
+                const glm::vec3 r_vec = other.com - p;
+                const float r_sq = dot(r_vec, r_vec);
+                const glm::vec3 ext = other.hi - other.lo;
+                const float size = std::max({ext.x, ext.y, ext.z});
+                if (size * size < theta_sq * r_sq) {
+                    acc += pair_accel(kForceLaw, self, other.aggregate, r_vec, r_sq);
+                    continue;
+                }
+            }
+
+            for (std::uint32_t j=other.begin; j<other.end; ++j) {
+                if (j == i) continue;
+
+                const glm::vec3 r_vec = v.pos[j] - p;
+                const float r_sq = dot(r_vec, r_vec);
+                acc += pair_accel(kForceLaw, self, v.props[j], r_vec, r_sq);
+            }
+        }
+
+        v.props[i].vel += acc * dt;
+        v.next_pos[i] = p + v.props[i].vel * dt;
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    v.domains[d].work_ns = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+// Child process entry, must not allocate: the parent may have had other threads at fork()
+[[noreturn]] void worker_main(SharedHeader* hdr, std::uint32_t d, pid_t parent)
+{
+    // the parent may have died before the death signal was armed, nobody would release the barrier
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() != parent)
+        _exit(EXIT_FAILURE);
+    const SharedView v = view_of(hdr);
+
+    for (;;) {
+        barrier_wait(hdr);
+        if (hdr->command == kCmdQuit)
+            break;
+
+        summarise(v, d);
+        barrier_wait(hdr);
+        integrate(v, d);
+        barrier_wait(hdr);
+    }
+    _exit(EXIT_SUCCESS);
+}
+}
+
+
+DomainDecomposition::DomainDecomposition(const State& state, DomainConfig config)
+    : config(config),
+      num_bodies(state.transforms.size())
+{
+    if (config.num_domains == 0)
+        throw std::runtime_error("DomainDecomposition needs at least one domain");
+    if (num_bodies >= kUnassigned)
+        throw std::runtime_error(std::format("DomainDecomposition: too many bodies ({})", num_bodies));
+
+    const ShmLayout layout = shm_layout(num_bodies, config.num_domains);
+    shared_bytes = layout.total;
+
+    const std::string name = std::format("/spacesim-domains-{}", getpid());
+    const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1)
+        throw std::runtime_error(std::format("shm_open failed: {}", std::strerror(errno)));
+
+    // the mapping survives the unlink and is inherited across fork()
+    shm_unlink(name.c_str());
+    if (ftruncate(fd, static_cast<off_t>(shared_bytes)) == -1) {
+        close(fd);
+        throw std::runtime_error(std::format("ftruncate failed: {}", std::strerror(errno)));
+    }
+    void* mem = mmap(nullptr, shared_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+        throw std::runtime_error(std::format("mmap failed: {}", std::strerror(errno)));
+
+    shared = static_cast<SharedHeader*>(mem);
+    shared->command = kCmdTick;
+    shared->dt = 0.0f;
+    shared->opening_angle = config.opening_angle;
+    shared->num_bodies = static_cast<std::uint32_t>(num_bodies);
+    shared->num_domains = config.num_domains;
+
+    pthread_barrierattr_t attr;
+    pthread_barrierattr_init(&attr);
+    pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    const int barrier_err = pthread_barrier_init(&shared->barrier, &attr, config.num_domains);
+    pthread_barrierattr_destroy(&attr);
+    if (barrier_err != 0) {
+        munmap(shared, shared_bytes);
+        shared = nullptr;
+        throw std::runtime_error(std::format("pthread_barrier_init failed: {}", std::strerror(barrier_err)));
+    }
+
+    // the destructor never runs for a partly built object, so every failure from here on
+    // has to take down the workers already forked before it propagates
+    try {
+        keys.resize(num_bodies);
+        slot_ids.resize(num_bodies);
+        std::iota(slot_ids.begin(), slot_ids.end(), 0u);
+        split_keys.assign(config.num_domains, 0);
+        domain_counts.assign(config.num_domains, 0);
+        domain_of.assign(num_bodies, kUnassigned);
+        body_cost.assign(num_bodies, 1.0f);
+        stats_.work_ns.assign(config.num_domains, 0);
+        stats_.counts.assign(config.num_domains, 0);
+        workers.reserve(config.num_domains - 1);
+
+        const pid_t parent = getpid();
+        for (std::uint32_t d=1; d<config.num_domains; ++d) {
+            const pid_t pid = fork();
+            if (pid == 0)
+                worker_main(shared, d, parent);
+            if (pid == -1)
+                throw std::runtime_error(std::format("fork failed: {}", std::strerror(errno)));
+            workers.push_back(pid);
+        }
+    } catch (...) {
+        abandon();
+        throw;
+    }
+}
+
+// Kills and reaps the workers, which may be blocked on the barrier, then releases the segment.
+// The barrier is not destroyed: glibc waits for blocked threads to leave it, and the killed
+// workers never will. Nothing else maps the segment, so the unmap is the end of it
+void DomainDecomposition::abandon() noexcept
+{
+    for (int child : workers) {
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+    }
+    workers.clear();
+    munmap(shared, shared_bytes);
+    shared = nullptr;
+}
+
+DomainDecomposition::~DomainDecomposition()
+{
+    if (!shared)
+        return;
+
+    shared->command = kCmdQuit;
+    barrier_wait(shared);
+    for (int child : workers)
+        waitpid(child, nullptr, 0);
+
+    pthread_barrier_destroy(&shared->barrier);
+    munmap(shared, shared_bytes);
+}
+
+void DomainDecomposition::tick(State& state, float dt)
+{
+    if (state.transforms.size() != num_bodies)
+        throw std::runtime_error(std::format(
+            "DomainDecomposition: body count changed from {} to {}", num_bodies, state.transforms.size()));
+
+    const SharedView v = view_of(shared);
+
+    gather(state, &state.arena.shared());
+    shared->command = kCmdTick;
+    shared->dt = dt;
+
+    barrier_wait(shared);
+    summarise(v, 0);
+    barrier_wait(shared);
+    integrate(v, 0);
+    barrier_wait(shared);
+
+    scatter(state);
+    rebalance();
+}
+
+void DomainDecomposition::on_reorder(const std::vector<std::uint32_t>& new_to_old)
+{
+    reorder_domain_of.resize(num_bodies);
+    reorder_cost.resize(num_bodies);
+    for (std::size_t i=0; i<num_bodies; ++i) {
+        reorder_domain_of[i] = domain_of[new_to_old[i]];
+        reorder_cost[i]      = body_cost[new_to_old[i]];
+    }
+    std::swap(domain_of, reorder_domain_of);
+    std::swap(body_cost, reorder_cost);
+
+    // the kept slot order names bodies by index, which just changed
+    slot_tmp.resize(num_bodies);
+    for (std::size_t i=0; i<num_bodies; ++i)
+        slot_tmp[new_to_old[i]] = static_cast<std::uint32_t>(i);
+    for (std::uint32_t& id : slot_ids)
+        id = slot_tmp[id];
+}
+
+// Keeps the Morton frame while it still fits: rebuilt with some slack when a body leaves it
+// or the bodies have shrunk to under half of it. Returns whether it was rebuilt
+bool DomainDecomposition::update_frame(const State& state)
+{
+    glm::vec3 lo{std::numeric_limits<float>::max()};
+    glm::vec3 hi{std::numeric_limits<float>::lowest()};
+    for (const Transform& tf : state.transforms) {
+        lo = glm::min(lo, tf.pos);
+        hi = glm::max(hi, tf.pos);
+    }
+
+    const glm::vec3 ext = hi - lo;
+    const glm::vec3 frame_ext = frame_hi - frame_lo;
+    const float size = std::max({ext.x, ext.y, ext.z});
+    const bool inside = glm::min(lo, frame_lo) == frame_lo && glm::max(hi, frame_hi) == frame_hi;
+    if (inside && 2.0f * size >= std::max({frame_ext.x, frame_ext.y, frame_ext.z}))
+        return false;
+
+    const glm::vec3 slack{0.05f * size + 1e-6f};
+    frame_lo = lo - slack;
+    frame_hi = hi + slack;
+    frame_inv_extent = 1.0f / (frame_hi - frame_lo);
+    return true;
+}
+
+// Domain d owns the keys in [split_keys[d], split_keys[d + 1]). Between re-splits the split
+// keys stay put and a body only changes domain when its own key crosses one, so a tick is a
+// linear stable partition of last tick's slot order instead of a sort
+void DomainDecomposition::gather(const State& state, std::pmr::memory_resource* scratch)
+{
+    const SharedView v = view_of(shared);
+    const Transform* tfs = state.transforms.data();
+
+    if (update_frame(state))
+        needs_split = true;
+    parallel_for(num_bodies, kMinChunk, [&](std::size_t begin, std::size_t end, unsigned) {
+        for (std::size_t slot=begin; slot<end; ++slot)
+            keys[slot] = morton_key(tfs[slot_ids[slot]].pos, frame_lo, frame_inv_extent);
+    });
+
+    stats_.resplit = needs_split;
+    if (needs_split)
+        split_by_cost(scratch);
+    else
+        partition_by_key();
+    needs_split = false;
+
+    parallel_for(num_bodies, kMinChunk, [&](std::size_t begin, std::size_t end, unsigned) {
+        for (std::size_t slot=begin; slot<end; ++slot) {
+            v.pos[slot]   = tfs[slot_ids[slot]].pos;
+            v.props[slot] = state.props[slot_ids[slot]];
+        }
+    });
+}
+
+// Sorts every body by key and cuts the order into runs of equal measured cost
+void DomainDecomposition::split_by_cost(std::pmr::memory_resource* scratch)
+{
+    const SharedView v = view_of(shared);
+    const std::uint32_t num_domains = config.num_domains;
+
+    radix_sort_pairs(keys, slot_ids, keys_tmp, slot_tmp, scratch);
+
+    float total_cost = 0.0f;
+    for (const float cost : body_cost)
+        total_cost += cost;
+
+    const float target = total_cost / static_cast<float>(num_domains);
+    std::uint32_t d = 0;
+    float acc = 0.0f;
+    stats_.migrated = 0;
+    v.domains[0].begin = 0;
+
+    for (std::uint32_t slot=0; slot<num_bodies; ++slot) {
+        while (d + 1 < num_domains && acc >= target * static_cast<float>(d + 1)) {
+            v.domains[d].end = slot;
+            v.domains[++d].begin = slot;
+        }
+
+        const std::uint32_t id = slot_ids[slot];
+        acc += body_cost[id];
+
+        if (domain_of[id] != kUnassigned && domain_of[id] != d)
+            ++stats_.migrated;
+        domain_of[id] = d;
+    }
+
+    v.domains[d].end = static_cast<std::uint32_t>(num_bodies);
+    for (std::uint32_t e=d+1; e<num_domains; ++e) {
+        v.domains[e].begin = static_cast<std::uint32_t>(num_bodies);
+        v.domains[e].end   = static_cast<std::uint32_t>(num_bodies);
+    }
+
+    // a run's first key, or past every key for a domain left empty
+    for (std::uint32_t e=1; e<num_domains; ++e) {
+        const std::uint32_t begin = v.domains[e].begin;
+        split_keys[e] = begin < num_bodies ? keys[begin] : std::numeric_limits<std::uint32_t>::max();
+    }
+}
+
+// Counting pass over the domains: stable, so bodies that stay keep their order
+void DomainDecomposition::partition_by_key()
+{
+    const SharedView v = view_of(shared);
+    const std::uint32_t num_domains = config.num_domains;
+
+    std::fill(domain_counts.begin(), domain_counts.end(), 0u);
+    stats_.migrated = 0;
+    for (std::uint32_t slot=0; slot<num_bodies; ++slot) {
+        const auto d = static_cast<std::uint32_t>(
+            std::upper_bound(split_keys.begin() + 1, split_keys.end(), keys[slot]) - (split_keys.begin() + 1));
+        const std::uint32_t id = slot_ids[slot];
+        if (domain_of[id] != d)
+            ++stats_.migrated;
+        domain_of[id] = d;
+        ++domain_counts[d];
+    }
+
+    std::uint32_t offset = 0;
+    for (std::uint32_t d=0; d<num_domains; ++d) {
+        v.domains[d].begin = offset;
+        offset += domain_counts[d];
+        v.domains[d].end = offset;
+        domain_counts[d] = v.domains[d].begin;
+    }
+
+    keys_tmp.resize(num_bodies);
+    slot_tmp.resize(num_bodies);
+    for (std::uint32_t slot=0; slot<num_bodies; ++slot) {
+        const std::uint32_t dst = domain_counts[domain_of[slot_ids[slot]]]++;
+        keys_tmp[dst] = keys[slot];
+        slot_tmp[dst] = slot_ids[slot];
+    }
+    std::swap(keys, keys_tmp);
+    std::swap(slot_ids, slot_tmp);
+}
+
+void DomainDecomposition::scatter(State& state) const
+{
+    const SharedView v = view_of(shared);
+    parallel_for(num_bodies, kMinChunk, [&](std::size_t begin, std::size_t end, unsigned) {
+        for (std::size_t slot=begin; slot<end; ++slot) {
+            const std::uint32_t id = slot_ids[slot];
+            state.transforms[id].pos = v.next_pos[slot];
+            state.props[id].vel      = v.props[slot].vel;
+        }
+    });
+}
+
+// Spreads each domain's measured time over its bodies, smoothed to damp oscillation
+void DomainDecomposition::rebalance()
+{
+    constexpr float kSmoothing = 0.5f;
+    const SharedView v = view_of(shared);
+
+    for (std::uint32_t d=0; d<config.num_domains; ++d) {
+        const DomainSummary& s = v.domains[d];
+        const std::uint32_t count = s.end - s.begin;
+        stats_.work_ns[d] = s.work_ns;
+        stats_.counts[d] = count;
+        if (count == 0)
+            continue;
+
+        const float per_body = static_cast<float>(s.work_ns) / static_cast<float>(count);
+        for (std::uint32_t slot=s.begin; slot<s.end; ++slot) {
+            float& cost = body_cost[slot_ids[slot]];
+            cost = kSmoothing * cost + (1.0f - kSmoothing) * per_body;
+        }
+    }
+
+    // the split keys only move once the slowest domain falls too far behind the mean
+    std::uint64_t total = 0, slowest = 0;
+    for (const std::uint64_t ns : stats_.work_ns) {
+        total += ns;
+        slowest = std::max(slowest, ns);
+    }
+    const double mean = static_cast<double>(total) / config.num_domains;
+    if (static_cast<double>(slowest) > (1.0 + config.max_imbalance) * mean)
+        needs_split = true;
+}
+
+#else
+
+DomainDecomposition::DomainDecomposition(const State&, DomainConfig config)
+    : config(config), num_bodies(0)
+{
+    throw std::runtime_error("DomainDecomposition is only available on Linux");
+}
+
+DomainDecomposition::~DomainDecomposition() = default;
+
+void DomainDecomposition::tick(State&, float) {}
+void DomainDecomposition::on_reorder(const std::vector<std::uint32_t>&) {}
+bool DomainDecomposition::update_frame(const State&) { return false; }
+void DomainDecomposition::gather(const State&, std::pmr::memory_resource*) {}
+void DomainDecomposition::split_by_cost(std::pmr::memory_resource*) {}
+void DomainDecomposition::partition_by_key() {}
+void DomainDecomposition::scatter(State&) const {}
+void DomainDecomposition::rebalance() {}
+void DomainDecomposition::abandon() noexcept {}
+
+#endif
@@ -0,0 +1,209 @@
+#include "frame_recorder.hpp"
+
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <stdexcept>
+
+#include <glad/glad.h>
+
+#include "image_io.hpp"
+
+
+namespace
+{
+constexpr GLuint64 kFenceTimeoutNs = 1'000'000'000ull;
+}
+
+FrameRecorder::FrameRecorder(const RecorderConfig& config)
+    : config(config),
+      frame_bytes(std::size_t{config.width} * config.height * 4)
+{
+    if (config.ring_size == 0 || config.writer_threads == 0)
+        throw std::runtime_error("FrameRecorder needs at least one PBO and one writer thread");
+    std::filesystem::create_directories(config.out_dir);
+
+    const auto w = static_cast<GLsizei>(config.width);
+    const auto h = static_cast<GLsizei>(config.height);
+
+    glCreateRenderbuffers(1, &colour_rb);
+    glNamedRenderbufferStorage(colour_rb, GL_RGBA8, w, h);
+    glCreateRenderbuffers(1, &depth_rb);
+    glNamedRenderbufferStorage(depth_rb, GL_DEPTH_COMPONENT24, w, h);
+
+    glCreateFramebuffers(1, &fbo);
+    glNamedFramebufferRenderbuffer(fbo, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colour_rb);
+    glNamedFramebufferRenderbuffer(fbo, GL_DEPTH_ATTACHMENT,  GL_RENDERBUFFER, depth_rb);
+    glNamedFramebufferReadBuffer(fbo, GL_COLOR_ATTACHMENT0);
+    if (glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        throw std::runtime_error("offscreen framebuffer incomplete");
+
+    // persistently mapped: a slot is read straight from its mapping once fenced
+    constexpr GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    ring.resize(config.ring_size);
+    for (Slot& slot : ring) {
+        glCreateBuffers(1, &slot.pbo);
+        glNamedBufferStorage(slot.pbo, static_cast<GLsizeiptr>(frame_bytes), nullptr, flags | GL_CLIENT_STORAGE_BIT);
+        slot.mapped = static_cast<const std::uint8_t*>(
+            glMapNamedBufferRange(slot.pbo, 0, static_cast<GLsizeiptr>(frame_bytes), flags));
+        if (!slot.mapped)
+            throw std::runtime_error("failed to map pixel pack buffer");
+    }
+
+    for (unsigned t=0; t<config.writer_threads; ++t)
+        writers.emplace_back(&FrameRecorder::writer_loop, this);
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    try {
+        finish();
+    } catch (const std::exception& e) {
+        std::cerr << "FrameRecorder: " << e.what() << std::endl;
+    }
+
+    {
+        std::lock_guard lock(mtx);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    for (auto& t : writers)
+        t.join();
+
+    for (Slot& slot : ring) {
+        if (slot.fence) glDeleteSync(slot.fence);
+        glUnmapNamedBuffer(slot.pbo);
+        glDeleteBuffers(1, &slot.pbo);
+    }
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &colour_rb);
+    glDeleteRenderbuffers(1, &depth_rb);
+}
+
+void FrameRecorder::bind() const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, static_cast<GLsizei>(config.width), static_cast<GLsizei>(config.height));
+}
+
+void FrameRecorder::capture()
+{
+    Slot& slot = ring[head];
+    if (slot.fence)
+        retire(slot, true); // ring full: the oldest readback must land first
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, static_cast<GLsizei>(config.width), static_cast<GLsizei>(config.height),
+                 GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = next_frame++;
+    head = (head + 1) % static_cast<std::uint32_t>(ring.size());
+
+    // hand off anything that already finished, oldest first, without waiting
+    for (std::size_t k=0; k<ring.size(); ++k) {
+        Slot& s = ring[(head + k) % ring.size()];
+        if (s.fence)
+            retire(s, false);
+    }
+}
+
+// Copies a finished slot out to a writer; without `block` it returns early if the GPU is still busy
+void FrameRecorder::retire(Slot& slot, bool block)
+{
+    GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, block ? kFenceTimeoutNs : 0);
+    if (status == GL_TIMEOUT_EXPIRED && !block)
+        return;
+    while (status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(slot.fence, 0, kFenceTimeoutNs);
+    if (status == GL_WAIT_FAILED)
+        throw std::runtime_error(std::format("readback of frame {} failed", slot.frame));
+
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    std::vector<std::uint8_t> pixels;
+    {
+        std::unique_lock lock(mtx);
+        const std::size_t max_queued = 2 * writers.size();
+        space_ready.wait(lock, [&] { return queue.size() < max_queued; });
+        if (!free_buffers.empty()) {
+            pixels = std::move(free_buffers.back());
+            free_buffers.pop_back();
+        }
+    }
+    pixels.resize(frame_bytes);
+    std::memcpy(pixels.data(), slot.mapped, frame_bytes);
+
+    {
+        std::lock_guard lock(mtx);
+        queue.push_back(Job{slot.frame, std::move(pixels)});
+    }
+    work_ready.notify_one();
+}
+
+void FrameRecorder::finish()
+{
+    // drain the ring in frame order
+    for (std::size_t k=0; k<ring.size(); ++k) {
+        Slot& s = ring[(head + k) % ring.size()];
+        if (s.fence)
+            retire(s, true);
+    }
+
+    std::unique_lock lock(mtx);
+    space_ready.wait(lock, [&] { return queue.empty() && in_progress == 0; });
+}
+
+std::uint64_t FrameRecorder::frames_written() const
+{
+    std::lock_guard lock(mtx);
+    return written;
+}
+
+std::uint64_t FrameRecorder::frames_failed() const
+{
+    std::lock_guard lock(mtx);
+    return failed;
+}
+
+void FrameRecorder::writer_loop()
+{
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock lock(mtx);
+            work_ready.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (queue.empty())
+                return;
+            job = std::move(queue.front());
+            queue.pop_front();
+            ++in_progress;
+        }
+        space_ready.notify_all();
+
+        bool ok = true;
+        try {
+            const bool png = config.format == ImageFormat::Png;
+            const auto path = config.out_dir / std::format("frame_{:06}.{}", job.frame, png ? "png" : "rgba");
+            if (png)
+                write_png(path, config.width, config.height, job.pixels.data(), true);
+            else
+                write_raw_rgba(path, config.width, config.height, job.pixels.data(), true);
+        } catch (const std::exception& e) {
+            std::cerr << "FrameRecorder: " << e.what() << std::endl;
+            ok = false;
+        }
+
+        {
+            std::lock_guard lock(mtx);
+            free_buffers.push_back(std::move(job.pixels));
+            --in_progress;
+            ++(ok ? written : failed);
+        }
+        space_ready.notify_all();
+    }
+}
@@ -0,0 +1,231 @@
+#include "generators.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "constants.hpp"
+#include "parallel.hpp"
+#include "rng.hpp"
+#include "state.hpp"
+
+
+namespace
+{
+constexpr std::size_t kMinChunk = 1 << 14;
+constexpr glm::quat kIdentity{1.0f, 0, 0, 0};
+
+// salts keep the streams of different generators apart for the same seed
+constexpr std::uint64_t kPlummerSalt   = 0x01ull << 56;
+constexpr std::uint64_t kHernquistSalt = 0x02ull << 56;
+constexpr std::uint64_t kDiskSalt      = 0x03ull << 56;
+constexpr std::uint64_t kBulgeSalt     = 0x04ull << 56;
+constexpr std::uint64_t kCubeSalt      = 0x05ull << 56;
+constexpr std::uint64_t kPlanetSalt    = 0x06ull << 56;
+
+struct Sample {
+    glm::vec3 pos;
+    glm::vec3 vel;
+    float mass;
+};
+
+// Appends `count` bodies and fills body k from sample(rng_k, k), in parallel
+template <class Sampler>
+void emit(State& state, std::size_t count, std::uint64_t seed, std::uint64_t salt,
+          const BodyStyle& style, Sampler&& sample)
+{
+    if (count == 0)
+        return;
+
+    const std::size_t first = state.append_bodies(count, style.mesh_id);
+    parallel_for(count, kMinChunk, [&](std::size_t begin, std::size_t end, unsigned) {
+        for (std::size_t k=begin; k<end; ++k) {
+            CounterRng rng(seed, salt | k);
+            const Sample s = sample(rng, k);
+
+            const std::size_t i = first + k;
+            state.transforms[i] = Transform{s.pos, kIdentity, style.radius};
+            state.props[i] = make_props(s.vel, s.mass);
+            state.albedo[state.ids[i]] = style.colour;
+        }
+    });
+}
+
+// isotropic velocity with the given 1D dispersion, speed capped below escape
+glm::vec3 maxwellian(CounterRng& rng, float sigma, float v_esc)
+{
+    glm::vec3 v{rng.normal() * sigma, rng.normal() * sigma, rng.normal() * sigma};
+    const float speed = glm::length(v);
+    const float cap = 0.95f * v_esc;
+    return speed > cap ? v * (cap / speed) : v;
+}
+
+// Hernquist (1990) eq. 10, isotropic radial velocity dispersion squared
+float hernquist_sigma_sq(float r, float mass, float a)
+{
+    const float x = r / a;
+    const float sum = 25.0f + x * (52.0f + x * (42.0f + x * 12.0f));
+    const float v = (kGravity * mass / (12.0f * a))
+                  * (12.0f * x * std::pow(1.0f + x, 3.0f) * std::log((r + a) / r) - x / (1.0f + x) * sum);
+    return std::max(v, 0.0f);
+}
+
+Sample sample_hernquist(CounterRng& rng, float mass, float a, float body_mass)
+{
+    // inverse of M(<r)/M = r^2 / (r + a)^2, capped to avoid the unbounded tail
+    const float u = std::min(rng.uniform_open(), 0.999f);
+    const float su = std::sqrt(u);
+    const float r = a * su / (1.0f - su);
+
+    const float v_esc = std::sqrt(2.0f * kGravity * mass / (r + a));
+    const float sigma = std::sqrt(hernquist_sigma_sq(r, mass, a));
+    return Sample{r * rng.unit_vector(), maxwellian(rng, sigma, v_esc), body_mass};
+}
+
+// orthonormal u, v spanning the plane perpendicular to n
+void plane_basis(const glm::vec3& n, glm::vec3& u, glm::vec3& v)
+{
+    const glm::vec3 helper = std::abs(n.x) < 0.9f ? glm::vec3{1, 0, 0} : glm::vec3{0, 1, 0};
+    u = glm::normalize(glm::cross(helper, n));
+    v = glm::cross(n, u);
+}
+}
+
+
+void generate_plummer(State& state, const PlummerParams& params, std::uint64_t seed)
+{
+    const float a = params.scale_radius;
+    const float body_mass = params.total_mass / static_cast<float>(params.count);
+
+    // Aarseth, Henon & Wielen (1974)
+    emit(state, params.count, seed, kPlummerSalt, params.style, [&](CounterRng& rng, std::size_t) {
+        const float u = std::min(rng.uniform_open(), 0.999f);
+        const float r = a / std::sqrt(std::pow(u, -2.0f / 3.0f) - 1.0f);
+
+        float q = 0.0f;
+        for (;;) {
+            q = rng.uniform();
+            const float g = q * q * std::pow(1.0f - q * q, 3.5f);
+            if (0.1f * rng.uniform() < g)
+                break;
+        }
+        const float v_esc = std::sqrt(2.0f * kGravity * params.total_mass) * std::pow(r * r + a * a, -0.25f);
+
+        return Sample{params.centre + r * rng.unit_vector(),
+                      params.bulk_vel + q * v_esc * rng.unit_vector(),
+                      body_mass};
+    });
+}
+
+void generate_hernquist(State& state, const HernquistParams& params, std::uint64_t seed)
+{
+    const float body_mass = params.total_mass / static_cast<float>(params.count);
+
+    emit(state, params.count, seed, kHernquistSalt, params.style, [&](CounterRng& rng, std::size_t) {
+        Sample s = sample_hernquist(rng, params.total_mass, params.scale_radius, body_mass);
+        s.pos += params.centre;
+        s.vel += params.bulk_vel;
+        return s;
+    });
+}
+
+void generate_disk_galaxy(State& state, const DiskGalaxyParams& params, std::uint64_t seed)
+{
+    const glm::vec3 n = glm::normalize(params.normal);
+    glm::vec3 u, v;
+    plane_basis(n, u, v);
+
+    const float rd = params.scale_length;
+    const float a = params.bulge_radius;
+
+    // spherically-averaged enclosed mass, good enough to set circular speeds
+    auto enclosed = [&](float r) {
+        const float disk = params.disk_mass * (1.0f - (1.0f + r / rd) * std::exp(-r / rd));
+        const float bulge = params.bulge_mass * r * r / ((r + a) * (r + a));
+        return disk + bulge;
+    };
+
+    if (params.disk_count > 0) {
+        const float body_mass = params.disk_mass / static_cast<float>(params.disk_count);
+        emit(state, params.disk_count, seed, kDiskSalt, params.disk_style, [&](CounterRng& rng, std::size_t) {
+            constexpr float two_pi = 6.28318530717958647692f;
+
+            // surface density ~ exp(-R/R_d) => R ~ Gamma(2, R_d)
+            const float r = -rd * std::log(rng.uniform_open() * rng.uniform_open());
+            const float phi = two_pi * rng.uniform();
+            const float z = params.scale_height * std::atanh(std::clamp(2.0f * rng.uniform() - 1.0f, -0.999f, 0.999f));
+
+            const glm::vec3 radial = std::cos(phi) * u + std::sin(phi) * v;
+            const glm::vec3 tangent = glm::cross(n, radial);
+            const float v_c = std::sqrt(kGravity * enclosed(r) / std::max(r, 1e-3f));
+            const float sigma = params.velocity_dispersion * v_c;
+
+            const glm::vec3 vel = v_c * tangent
+                                + glm::vec3{rng.normal(), rng.normal(), rng.normal()} * sigma;
+            return Sample{params.centre + r * radial + z * n, vel, body_mass};
+        });
+    }
+
+    if (params.bulge_count > 0) {
+        const float body_mass = params.bulge_mass / static_cast<float>(params.bulge_count);
+        emit(state, params.bulge_count, seed, kBulgeSalt, params.bulge_style, [&](CounterRng& rng, std::size_t) {
+            Sample s = sample_hernquist(rng, params.bulge_mass, a, body_mass);
+            s.pos += params.centre;
+            return s;
+        });
+    }
+}
+
+void generate_uniform_cube(State& state, const UniformCubeParams& params, std::uint64_t seed)
+{
+    const float body_mass = params.total_mass / static_cast<float>(params.count);
+    const float half = 0.5f * params.side;
+
+    emit(state, params.count, seed, kCubeSalt, params.style, [&](CounterRng& rng, std::size_t) {
+        const glm::vec3 pos{rng.uniform(-half, half), rng.uniform(-half, half), rng.uniform(-half, half)};
+        const float s = params.velocity_dispersion;
+        return Sample{params.centre + pos, glm::vec3{rng.normal(), rng.normal(), rng.normal()} * s, body_mass};
+    });
+}
+
+void generate_planetary_system(State& state, const PlanetarySystemParams& params, std::uint64_t seed)
+{
+    const std::uint32_t star = state.index_of.at(params.star_id);
+    const glm::vec3 star_pos = state.transforms[star].pos;
+    const glm::vec3 star_vel = state.props[star].vel;
+    const float gm = kGravity * mass_of(state.props[star]);
+
+    const float log_inner = std::log(params.inner_radius);
+    const float log_outer = std::log(params.outer_radius);
+
+    emit(state, params.count, seed, kPlanetSalt, params.style, [&](CounterRng& rng, std::size_t) {
+        constexpr float two_pi = 6.28318530717958647692f;
+
+        const float sma = std::exp(rng.uniform(log_inner, log_outer));
+        const float e = params.max_eccentricity * rng.uniform();
+        const float phase = two_pi * rng.uniform();
+        const float incl = params.max_inclination * (2.0f * rng.uniform() - 1.0f);
+        const float node = two_pi * rng.uniform();
+
+        // start at a random true anomaly on the ellipse, vis-viva for the speed
+        const float r = sma * (1.0f - e * e) / (1.0f + e * std::cos(phase));
+        const float speed = std::sqrt(gm * (2.0f / r - 1.0f / sma));
+
+        // orbital plane: xy tilted by `incl` about the line of nodes
+        const glm::vec3 line{std::cos(node), std::sin(node), 0.0f};
+        const glm::vec3 perp{-std::sin(node) * std::cos(incl), std::cos(node) * std::cos(incl), std::sin(incl)};
+        const float theta = phase;
+        const glm::vec3 radial = std::cos(theta) * line + std::sin(theta) * perp;
+        const glm::vec3 tangent = -std::sin(theta) * line + std::cos(theta) * perp;
+
+        // flight-path angle from the radial velocity component of an ellipse
+        const float h = std::sqrt(gm * sma * (1.0f - e * e));
+        const float v_r = gm / h * e * std::sin(phase);
+        const float v_t = std::sqrt(std::max(speed * speed - v_r * v_r, 0.0f));
+
+        return Sample{star_pos + r * radial,
+                      star_vel + v_r * radial + v_t * tangent,
+                      rng.uniform(params.min_mass, params.max_mass)};
+    });
+}
@@ -0,0 +1,76 @@
+#include "headless.hpp"
+
+#include <stdexcept>
+
+#if defined(__linux__)
+
+#include <format>
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+
+HeadlessContext::HeadlessContext()
+{
+    auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+
+    EGLDisplay dpy = EGL_NO_DISPLAY;
+    if (get_platform_display)
+        dpy = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (dpy == EGL_NO_DISPLAY)
+        dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (dpy == EGL_NO_DISPLAY || !eglInitialize(dpy, &major, &minor))
+        throw std::runtime_error(std::format("EGL initialisation failed (0x{:x})", eglGetError()));
+    display = dpy;
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        eglTerminate(dpy);
+        throw std::runtime_error("EGL: desktop OpenGL API unavailable");
+    }
+
+    const EGLint attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 5,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    // EGL_KHR_no_config_context + EGL_KHR_surfaceless_context
+    EGLContext ctx = eglCreateContext(dpy, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+    if (ctx == EGL_NO_CONTEXT || !eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx)) {
+        const EGLint err = eglGetError();
+        if (ctx != EGL_NO_CONTEXT)
+            eglDestroyContext(dpy, ctx);
+        eglTerminate(dpy);
+        throw std::runtime_error(std::format("EGL: could not create a surfaceless GL 4.5 context (0x{:x})", err));
+    }
+    context = ctx;
+
+    if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+        eglMakeCurrent(dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(dpy, ctx);
+        eglTerminate(dpy);
+        throw std::runtime_error("gladLoadGLLoader failed");
+    }
+}
+
+HeadlessContext::~HeadlessContext()
+{
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+}
+
+#else
+
+HeadlessContext::HeadlessContext()
+{
+    throw std::runtime_error("headless rendering is only available on Linux (EGL)");
+}
+
+HeadlessContext::~HeadlessContext() = default;
+
+#endif
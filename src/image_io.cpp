@@ -0,0 +1,195 @@
+#include "image_io.hpp"
+
+#include <array>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+constexpr std::array<std::uint32_t, 256> make_crc_table()
+{
+    std::array<std::uint32_t, 256> table{};
+    for (std::uint32_t n=0; n<256; ++n) {
+        std::uint32_t c = n;
+        for (int k=0; k<8; ++k)
+            c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        table[n] = c;
+    }
+    return table;
+}
+
+constexpr auto crc_table = make_crc_table();
+
+std::uint32_t crc_update(std::uint32_t crc, const std::uint8_t* data, std::size_t len)
+{
+    for (std::size_t i=0; i<len; ++i)
+        crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+struct Adler32 {
+    std::uint32_t a = 1, b = 0;
+
+    void update(const std::uint8_t* data, std::size_t len)
+    {
+        constexpr std::uint32_t kMod = 65521;
+        constexpr std::size_t kBlock = 5552; // largest run without 32-bit overflow
+        while (len > 0) {
+            const std::size_t n = len < kBlock ? len : kBlock;
+            for (std::size_t i=0; i<n; ++i) {
+                a += data[i];
+                b += a;
+            }
+            a %= kMod;
+            b %= kMod;
+            data += n;
+            len -= n;
+        }
+    }
+    std::uint32_t value() const { return (b << 16) | a; }
+};
+
+void put_u32(std::uint8_t* out, std::uint32_t v)
+{
+    out[0] = static_cast<std::uint8_t>(v >> 24);
+    out[1] = static_cast<std::uint8_t>(v >> 16);
+    out[2] = static_cast<std::uint8_t>(v >> 8);
+    out[3] = static_cast<std::uint8_t>(v);
+}
+
+// Streams one PNG chunk whose payload is produced piecewise, CRC accumulated on the fly
+class ChunkWriter {
+public:
+    ChunkWriter(std::ofstream& file, const char (&type)[5], std::uint32_t length)
+        : file(file)
+    {
+        std::uint8_t hdr[8];
+        put_u32(hdr, length);
+        for (int i=0; i<4; ++i)
+            hdr[4 + i] = static_cast<std::uint8_t>(type[i]);
+        file.write(reinterpret_cast<const char*>(hdr), 8);
+        crc = crc_update(0xffffffffu, hdr + 4, 4);
+    }
+
+    void write(const std::uint8_t* data, std::size_t len)
+    {
+        file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(len));
+        crc = crc_update(crc, data, len);
+    }
+
+    void finish()
+    {
+        std::uint8_t tail[4];
+        put_u32(tail, crc ^ 0xffffffffu);
+        file.write(reinterpret_cast<const char*>(tail), 4);
+    }
+
+private:
+    std::ofstream& file;
+    std::uint32_t crc;
+};
+
+std::ofstream open_for_write(const std::filesystem::path& path)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        throw std::runtime_error("Unable to open file for writing: " + path.string());
+    return file;
+}
+}
+
+void write_png(const std::filesystem::path& path,
+               std::uint32_t width,
+               std::uint32_t height,
+               const std::uint8_t* rgba,
+               bool flip_y)
+{
+    constexpr std::size_t kMaxStored = 65535;
+    static constexpr std::uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+    std::ofstream file = open_for_write(path);
+    file.write(reinterpret_cast<const char*>(signature), sizeof signature);
+
+    {
+        std::uint8_t ihdr[13] = {};
+        put_u32(ihdr, width);
+        put_u32(ihdr + 4, height);
+        ihdr[8] = 8;  // bit depth
+        ihdr[9] = 6;  // colour type RGBA
+        ChunkWriter chunk(file, "IHDR", sizeof ihdr);
+        chunk.write(ihdr, sizeof ihdr);
+        chunk.finish();
+    }
+
+    // zlib stream = 2 byte header, stored deflate blocks (5 byte header each), adler32
+    const std::size_t row_bytes = std::size_t{width} * 4;
+    const std::size_t raw_bytes = (row_bytes + 1) * height; // +1 filter byte per row
+    const std::size_t num_blocks = raw_bytes == 0 ? 1 : (raw_bytes + kMaxStored - 1) / kMaxStored;
+    const std::size_t idat_bytes = 2 + num_blocks * 5 + raw_bytes + 4;
+
+    ChunkWriter idat(file, "IDAT", static_cast<std::uint32_t>(idat_bytes));
+    const std::uint8_t zlib_hdr[2] = {0x78, 0x01};
+    idat.write(zlib_hdr, 2);
+
+    Adler32 adler;
+    std::size_t block_left = 0;
+    std::size_t total_left = raw_bytes;
+
+    // emits `len` bytes of the uncompressed stream, opening stored blocks as needed
+    auto emit = [&](const std::uint8_t* data, std::size_t len) {
+        adler.update(data, len);
+        while (len > 0) {
+            if (block_left == 0) {
+                block_left = total_left < kMaxStored ? total_left : kMaxStored;
+                const auto l = static_cast<std::uint16_t>(block_left);
+                const std::uint8_t hdr[5] = {
+                    static_cast<std::uint8_t>(total_left == block_left ? 1 : 0),
+                    static_cast<std::uint8_t>(l & 0xff), static_cast<std::uint8_t>(l >> 8),
+                    static_cast<std::uint8_t>(~l & 0xff), static_cast<std::uint8_t>((~l >> 8) & 0xff),
+                };
+                idat.write(hdr, 5);
+            }
+            const std::size_t n = len < block_left ? len : block_left;
+            idat.write(data, n);
+            data += n;
+            len -= n;
+            block_left -= n;
+            total_left -= n;
+        }
+    };
+
+    const std::uint8_t filter_none = 0;
+    for (std::uint32_t y=0; y<height; ++y) {
+        const std::uint32_t src_row = flip_y ? height - 1 - y : y;
+        emit(&filter_none, 1);
+        emit(rgba + src_row * row_bytes, row_bytes);
+    }
+
+    std::uint8_t adler_be[4];
+    put_u32(adler_be, adler.value());
+    idat.write(adler_be, 4);
+    idat.finish();
+
+    ChunkWriter iend(file, "IEND", 0);
+    iend.finish();
+
+    if (!file)
+        throw std::runtime_error("Failed writing PNG: " + path.string());
+}
+
+void write_raw_rgba(const std::filesystem::path& path,
+                    std::uint32_t width,
+                    std::uint32_t height,
+                    const std::uint8_t* rgba,
+                    bool flip_y)
+{
+    std::ofstream file = open_for_write(path);
+    const std::size_t row_bytes = std::size_t{width} * 4;
+    for (std::uint32_t y=0; y<height; ++y) {
+        const std::uint32_t src_row = flip_y ? height - 1 - y : y;
+        file.write(reinterpret_cast<const char*>(rgba + src_row * row_bytes),
+                   static_cast<std::streamsize>(row_bytes));
+    }
+    if (!file)
+        throw std::runtime_error("Failed writing raw frame: " + path.string());
+}
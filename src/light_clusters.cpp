@@ -0,0 +1,300 @@
+#include "light_clusters.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+#include <glad/glad.h>
+
+#include "parallel.hpp"
+#include "shaders.hpp"
+#include "state.hpp"
+
+
+namespace
+{
+constexpr GLuint kLightsBinding = 1;
+constexpr GLuint kClustersBinding = 2;
+constexpr GLuint kIndicesBinding = 3;
+constexpr std::size_t kMinLights = 256;
+constexpr GLuint64 kFenceTimeoutNs = 1'000'000'000ull;
+
+float box_dist_sq(const glm::vec3& p, const glm::vec3& lo, const glm::vec3& hi)
+{
+    const glm::vec3 d = glm::max(glm::max(lo - p, p - hi), glm::vec3{0});
+    return dot(d, d);
+}
+
+std::size_t align_up(std::size_t bytes, std::size_t align)
+{
+    return (std::max<std::size_t>(bytes, 1) + align - 1) / align * align;
+}
+
+void wait_fence(GLsync& fence)
+{
+    if (!fence)
+        return;
+    GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, kFenceTimeoutNs);
+    while (status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(fence, 0, kFenceTimeoutNs);
+    glDeleteSync(fence);
+    fence = nullptr;
+    if (status == GL_WAIT_FAILED)
+        throw std::runtime_error("waiting for light buffer fence failed");
+}
+}
+
+LightClusters::LightClusters(ClusterConfig config, std::uint32_t ring_size)
+    : cfg(config),
+      ring_size(std::max(ring_size, 1u)),
+      fences(this->ring_size, nullptr)
+{
+    if (cfg.grid_x == 0 || cfg.grid_y == 0 || cfg.grid_z == 0 || cfg.max_lights_per_cluster == 0)
+        throw std::runtime_error("light cluster grid and capacity must be non-zero");
+
+    GLint align = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &align);
+    ssbo_align = std::max<std::size_t>(static_cast<std::size_t>(align), 16);
+
+    const std::size_t clusters = std::size_t{cfg.grid_x} * cfg.grid_y * cfg.grid_z;
+    counts.resize(clusters);
+    offsets.resize(clusters);
+    scratch.resize(clusters * cfg.max_lights_per_cluster);
+    slice_dropped.resize(cfg.grid_z);
+}
+
+LightClusters::~LightClusters()
+{
+    release();
+}
+
+void LightClusters::release()
+{
+    for (GLsync& f : fences) {
+        if (f) glDeleteSync(f);
+        f = nullptr;
+    }
+    if (buffer) {
+        glUnmapNamedBuffer(buffer);
+        glDeleteBuffers(1, &buffer);
+    }
+    buffer = 0;
+    mapped = nullptr;
+    region_bytes = 0;
+}
+
+void LightClusters::reserve(std::size_t bytes)
+{
+    if (bytes <= region_bytes)
+        return;
+
+    for (GLsync& f : fences)
+        wait_fence(f);
+    const std::size_t grown = std::max(bytes, region_bytes + region_bytes / 2);
+    release();
+
+    region_bytes = align_up(grown, ssbo_align);
+    const auto total = static_cast<GLsizeiptr>(region_bytes * ring_size);
+
+    constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, total, nullptr, flags);
+    mapped = static_cast<std::byte*>(glMapNamedBufferRange(buffer, 0, total, flags));
+    if (!mapped)
+        throw std::runtime_error("failed to map light buffer");
+}
+
+void LightClusters::set_projection(float fovy, float aspect, float near_plane, float far_plane)
+{
+    z_near = near_plane;
+    z_far = far_plane;
+
+    slice_depth.resize(cfg.grid_z + 1);
+    for (std::uint32_t k=0; k<=cfg.grid_z; ++k)
+        slice_depth[k] = z_near * std::pow(z_far / z_near, static_cast<float>(k) / cfg.grid_z);
+
+    // view space looks down -z; a tile's x/y extent grows linearly with depth
+    const float ty = std::tan(0.5f * fovy);
+    const float tx = ty * aspect;
+    boxes.resize(std::size_t{cfg.grid_x} * cfg.grid_y * cfg.grid_z);
+    for (std::uint32_t k=0; k<cfg.grid_z; ++k) {
+        const float d0 = slice_depth[k], d1 = slice_depth[k + 1];
+        for (std::uint32_t y=0; y<cfg.grid_y; ++y) {
+            const float y0 = (-1.0f + 2.0f * y / cfg.grid_y) * ty;
+            const float y1 = (-1.0f + 2.0f * (y + 1) / cfg.grid_y) * ty;
+            for (std::uint32_t x=0; x<cfg.grid_x; ++x) {
+                const float x0 = (-1.0f + 2.0f * x / cfg.grid_x) * tx;
+                const float x1 = (-1.0f + 2.0f * (x + 1) / cfg.grid_x) * tx;
+
+                Box& b = boxes[(std::size_t{k} * cfg.grid_y + y) * cfg.grid_x + x];
+                b.lo = {std::min(x0 * d0, x0 * d1), std::min(y0 * d0, y0 * d1), -d1};
+                b.hi = {std::max(x1 * d0, x1 * d1), std::max(y1 * d0, y1 * d1), -d0};
+            }
+        }
+    }
+}
+
+// only new models are looked at, unless a flag changed since the last scan
+void LightClusters::scan_emitters(const State& state)
+{
+    if (state.models.size() < models_scanned || state.light_version() != light_version) {
+        emitters.clear();
+        models_scanned = 0;
+        light_version = state.light_version();
+    }
+    for (; models_scanned<state.models.size(); ++models_scanned) {
+        if (state.models[models_scanned].is_light_source)
+            emitters.push_back(static_cast<std::uint32_t>(models_scanned));
+    }
+}
+
+void LightClusters::prepare(const State& state, float alpha, const glm::mat4& view)
+{
+    if (slice_depth.empty())
+        throw std::runtime_error("LightClusters::prepare called before set_projection");
+
+    const auto start = std::chrono::steady_clock::now();
+    scan_emitters(state);
+
+    const std::size_t num_lights = emitters.size();
+    const std::uint32_t cap = cfg.max_lights_per_cluster;
+    const std::size_t tiles = std::size_t{cfg.grid_x} * cfg.grid_y;
+    const std::size_t clusters = tiles * cfg.grid_z;
+
+    // worst case sizes, so the region is mapped before anything is written
+    lights_bytes = align_up(num_lights * sizeof(LightData), ssbo_align);
+    clusters_bytes = align_up(clusters * sizeof(glm::uvec2), ssbo_align);
+    clusters_offset = lights_bytes;
+    indices_offset = clusters_offset + clusters_bytes;
+    const std::size_t max_indices = clusters * std::min<std::size_t>(cap, num_lights);
+    reserve(indices_offset + align_up(max_indices * sizeof(std::uint32_t), ssbo_align));
+    wait_fence(fences[region]);
+    std::byte* base = mapped + region * region_bytes;
+
+    // emitters: interpolate, upload, and keep a view-space copy for assignment
+    auto* gpu_lights = reinterpret_cast<LightData*>(base);
+    view_lights.resize(num_lights);
+    intensities.resize(num_lights);
+    parallel_for(num_lights, kMinLights, [&](std::size_t begin, std::size_t end, unsigned) {
+        for (std::size_t l=begin; l<end; ++l) {
+            const Model& m = state.models[emitters[l]];
+            const std::uint32_t i = state.index_of[m.idx];
+            const Transform& a = state.prev_tfs[i];
+            const Transform& b = state.transforms[i];
+
+            const glm::vec3 pos = a.pos + alpha * (b.pos - a.pos);
+            const float scale = a.scale + alpha * (b.scale - a.scale);
+            const float intensity = cfg.intensity_per_area * scale * scale;
+            const float range = std::sqrt(intensity / cfg.cutoff);
+            // tinted by the emitter's colour, kept mostly white so every surface colour shows
+            const glm::vec3 c = 0.5f * (state.albedo[m.idx] + glm::vec3{1.0f});
+
+            gpu_lights[l] = LightData{{pos.x, pos.y, pos.z, range}, {c.x, c.y, c.z, intensity}};
+            const glm::vec4 v = view * glm::vec4{pos.x, pos.y, pos.z, 1.0f};
+            view_lights[l] = {v.x, v.y, v.z, range};
+            intensities[l] = intensity;
+        }
+    });
+
+    // assignment: one task per depth slice, each owning that slice's clusters
+    ThreadPool& pool = default_pool();
+    pool.run(cfg.grid_z, [&](std::size_t k, unsigned) {
+        const float d0 = slice_depth[k], d1 = slice_depth[k + 1];
+        const std::size_t first = k * tiles;
+        std::fill(counts.begin() + first, counts.begin() + first + tiles, 0u);
+        std::uint32_t dropped = 0;
+
+        for (std::size_t l=0; l<num_lights; ++l) {
+            const glm::vec4& vl = view_lights[l];
+            const glm::vec3 p{vl.x, vl.y, vl.z};
+            const float r = vl.w;
+            if (-p.z + r < d0 || -p.z - r > d1)
+                continue;
+
+            for (std::size_t c=first; c<first + tiles; ++c) {
+                const Box& box = boxes[c];
+                if (box_dist_sq(p, box.lo, box.hi) > r * r)
+                    continue;
+
+                std::uint32_t* list = &scratch[c * cap];
+                if (counts[c] < cap) {
+                    list[counts[c]++] = static_cast<std::uint32_t>(l);
+                    continue;
+                }
+
+                // full: the light contributing least at the cluster centre gives way
+                const glm::vec3 centre = 0.5f * (box.lo + box.hi);
+                const auto strength = [&](std::uint32_t j) {
+                    const glm::vec3 d = glm::vec3{view_lights[j].x, view_lights[j].y, view_lights[j].z} - centre;
+                    return intensities[j] / (dot(d, d) + 1.0f);
+                };
+                std::uint32_t weakest = 0;
+                float weakest_strength = strength(list[0]);
+                for (std::uint32_t s=1; s<cap; ++s) {
+                    const float st = strength(list[s]);
+                    if (st < weakest_strength) {
+                        weakest = s;
+                        weakest_strength = st;
+                    }
+                }
+                if (strength(static_cast<std::uint32_t>(l)) > weakest_strength)
+                    list[weakest] = static_cast<std::uint32_t>(l);
+                ++dropped;
+            }
+        }
+        slice_dropped[k] = dropped;
+    });
+
+    std::uint32_t total = 0;
+    for (std::size_t c=0; c<clusters; ++c) {
+        offsets[c] = total;
+        total += counts[c];
+    }
+    indices_bytes = align_up(total * sizeof(std::uint32_t), ssbo_align);
+
+    auto* gpu_clusters = reinterpret_cast<glm::uvec2*>(base + clusters_offset);
+    auto* gpu_indices = reinterpret_cast<std::uint32_t*>(base + indices_offset);
+    pool.run(cfg.grid_z, [&](std::size_t k, unsigned) {
+        for (std::size_t c=k * tiles; c<(k + 1) * tiles; ++c) {
+            gpu_clusters[c] = glm::uvec2{offsets[c], counts[c]};
+            std::copy_n(&scratch[c * cap], counts[c], gpu_indices + offsets[c]);
+        }
+    });
+
+    stats_.lights = static_cast<std::uint32_t>(num_lights);
+    stats_.assignments = total;
+    stats_.dropped = 0;
+    for (const std::uint32_t o : slice_dropped)
+        stats_.dropped += o;
+    stats_.build_ns = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+void LightClusters::bind(const ShaderProgram& program) const
+{
+    const auto region_offset = static_cast<GLintptr>(region * region_bytes);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, kLightsBinding, buffer,
+                      region_offset, static_cast<GLsizeiptr>(lights_bytes));
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, kClustersBinding, buffer,
+                      region_offset + static_cast<GLintptr>(clusters_offset), static_cast<GLsizeiptr>(clusters_bytes));
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, kIndicesBinding, buffer,
+                      region_offset + static_cast<GLintptr>(indices_offset), static_cast<GLsizeiptr>(indices_bytes));
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // slice = log(depth) * scale + bias, the inverse of slice_depth
+    const float log_ratio = std::log(z_far / z_near);
+    const float scale = cfg.grid_z / log_ratio;
+    program.set_uvec3("u_cluster_grid", glm::uvec3{cfg.grid_x, cfg.grid_y, cfg.grid_z});
+    program.set_vec2("u_cluster_tile", glm::vec2{static_cast<float>(cfg.grid_x) / viewport[2],
+                                                 static_cast<float>(cfg.grid_y) / viewport[3]});
+    program.set_vec4("u_cluster_depth", glm::vec4{z_near, z_far, scale, -scale * std::log(z_near)});
+}
+
+void LightClusters::end_frame()
+{
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % ring_size;
+}
@@ -4,21 +4,35 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cmath>
 #include <cstdint>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <stdexcept>
+#include <string>
 #include <string_view>
 #include <thread>
 
 #include "camera.hpp"
 #include "constants.hpp"
+#include "domain.hpp"
+#include "frame_recorder.hpp"
+#include "generators.hpp"
+#include "headless.hpp"
+#include "light_clusters.hpp"
 #include "mesh.hpp"
 #include "models.hpp"
 #include "read_file_to_string.hpp"
+#include "render_batch.hpp"
 #include "shaders.hpp"
+#include "spatial_query.hpp"
 #include "state.hpp"
+#include "trails.hpp"
 
 
 GLFWwindow* create_window()
@@ -69,20 +83,79 @@ ShaderProgram load_basic_shader()
     );
 }
 
-State create_state()
+struct SimOptions {
+    std::uint32_t tps = 60;
+    std::uint32_t target_fps = 144;
+    std::uint32_t max_updates_per_fl = 5;
+    std::uint32_t num_domains = 1;
+    std::uint32_t reorder_interval = 0;
+    float opening_angle = 0.0f;
+
+    // orbit trails, off when the length is 0
+    std::uint32_t trail_length = 0;
+    std::uint32_t trail_interval = 4;
+
+    std::string scene = "solar";
+    std::size_t scene_bodies = 10'000;
+    std::uint64_t seed = 1;
+    std::uint32_t emitters = 0;     // extra light sources among the scene's bodies
+
+    // offscreen recording, enabled by a non-empty directory
+    std::filesystem::path record_dir;
+    std::uint32_t record_frames = 600;
+    double frame_dt = 1.0 / 30.0;   // simulated seconds between recorded frames
+    ImageFormat image_format = ImageFormat::Png;
+    std::uint32_t width = kWidth;
+    std::uint32_t height = kHeight;
+};
+
+constexpr std::uint32_t kSphereMesh = 0;
+
+// the hand-placed star + two planets
+void add_solar_bodies(State& state)
 {
-    State state;
-    state.transforms.push_back(Transform{{0, 0, 0}, {1.0f, 0, 0, 0}, 2.5f});
-    state.transforms.push_back(Transform{{10, 5, 0}, {1.0f, 0, 0, 0}, 1.0f});
-    state.transforms.push_back(Transform{{-15, -5, 0}, {1.0f, 0, 0, 0}, 1.0f});
+    state.add_body(Transform{{0, 0, 0}, {1.0f, 0, 0, 0}, 2.5f},    make_props({0, 0, 0}, 100.0f),         colours[0]);
+    state.add_body(Transform{{10, 5, 0}, {1.0f, 0, 0, 0}, 1.0f},   make_props({0, -0.25f, -7.5f}, 1.0f),  colours[1]);
+    state.add_body(Transform{{-15, -5, 0}, {1.0f, 0, 0, 0}, 1.0f}, make_props({0, 0.25f, 6.5f}, 1.0f),    colours[2]);
 
-    state.props.push_back(PhysicsProps{{0, 0, 0}, 100.0f});
-    state.props.push_back(PhysicsProps{{0, -0.25f, -7.5f}, 1.0f});
-    state.props.push_back(PhysicsProps{{0, 0.25f, 6.5f}, 1.0f});
-    
     for (std::uint32_t i=0; i<kNumObjects; ++i) {
-        state.models.push_back(create_sphere(i, i==0));
+        state.models.emplace(Model{i, kSphereMesh, i==0});
+    }
+}
+
+State create_state(const SimOptions& opts)
+{
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+
+    State state;
+    state.meshes.emplace(create_sphere_mesh());
+
+    const std::size_t n = opts.scene_bodies;
+    if (opts.scene == "solar") {
+        add_solar_bodies(state);
+    } else if (opts.scene == "planets") {
+        add_solar_bodies(state);
+        generate_planetary_system(state, PlanetarySystemParams{ .count = n, .star_id = 0 }, opts.seed);
+    } else if (opts.scene == "plummer") {
+        generate_plummer(state, PlummerParams{ .count = n }, opts.seed);
+    } else if (opts.scene == "hernquist") {
+        generate_hernquist(state, HernquistParams{ .count = n }, opts.seed);
+    } else if (opts.scene == "galaxy") {
+        generate_disk_galaxy(state, DiskGalaxyParams{ .disk_count = n - n / 5, .bulge_count = n / 5 }, opts.seed);
+    } else if (opts.scene == "cube") {
+        generate_uniform_cube(state, UniformCubeParams{ .count = n }, opts.seed);
+    } else {
+        throw std::runtime_error(std::format("unknown scene '{}'", opts.scene));
     }
+
+    // spread evenly over the bodies, so generated scenes get many stars
+    const std::size_t emitters = std::min<std::size_t>(opts.emitters, state.models.size());
+    for (std::size_t e=0; e<emitters; ++e)
+        state.set_light_source(e * state.models.size() / emitters, true);
+
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count();
+    std::cout << "Scene '" << opts.scene << "': " << state.transforms.size() << " bodies in " << ms << " ms" << std::endl;
     return state;
 }
 }
@@ -94,29 +167,65 @@ class Sim {
     const std::uint32_t panic_update_cap;
     std::atomic_bool running{true};
 
-    GLFWwindow* window;
+    GLFWwindow* window; // null when rendering headless
     ShaderProgram shader_program;
     glm::mat4 proj_mat;
 
+    std::unique_ptr<FrameRecorder> recorder;
+    RenderBatch batch;
+    LightClusters lights;
+    std::unique_ptr<OrbitTrails> trails;
+
     State state;
+    SpatialQueries queries;
+    std::uint64_t ticks_done = 0;
+    bool pick_held = false;
+    std::uint32_t octree_rebuilds_seen = 0;
     Camera cam{{0.0f, 0.0f, 20.0f}, {0.0f, 1.0f, 0.0f}};
 
 public:
-    explicit Sim(GLFWwindow* window,
-                 std::uint32_t tps = 60,
-                 std::uint32_t target_fps = 144,
-                 std::uint32_t max_updates_per_fl = 5)
+    explicit Sim(GLFWwindow* window, const SimOptions& opts)
         : window(window),
-          tps(tps),
-          target_frame_ns{1'000'000'000ull / target_fps},
-          fixed_dt{1.0 / static_cast<double>(tps)},
-          panic_update_cap{max_updates_per_fl},
+          tps(opts.tps),
+          target_frame_ns{1'000'000'000ull / opts.target_fps},
+          fixed_dt{1.0 / static_cast<double>(opts.tps)},
+          panic_update_cap{opts.max_updates_per_fl},
           shader_program{ load_basic_shader() },
-          state{ create_state() }
+          state{ create_state(opts) }
     {
-        cam.window_setup(window);
+        if (window)
+            cam.window_setup(window);
+
+        if (!opts.record_dir.empty()) {
+            recorder = std::make_unique<FrameRecorder>(RecorderConfig{
+                .out_dir = opts.record_dir,
+                .width = opts.width,
+                .height = opts.height,
+                .format = opts.image_format,
+            });
+        }
 
-        proj_mat = glm::perspective(glm::radians(60.0f), float(kWidth)/kHeight, 0.1f, 100.0f);
+        // interpolation reads prev_tfs, which must be valid even if a frame is drawn before the first tick
+        state.swap();
+        state.reorder_config.interval_ticks = opts.reorder_interval;
+        state.opening_angle = opts.opening_angle;
+        if (opts.num_domains > 1)
+            state.enable_domains(DomainConfig{ .num_domains = opts.num_domains, .opening_angle = state.opening_angle });
+
+        const float fovy = glm::radians(60.0f), near_plane = 0.1f, far_plane = 100.0f;
+        const float aspect = float(opts.width)/opts.height;
+        proj_mat = glm::perspective(fovy, aspect, near_plane, far_plane);
+        lights.set_projection(fovy, aspect, near_plane, far_plane);
+
+        if (opts.trail_length > 0) {
+            trails = std::make_unique<OrbitTrails>(TrailConfig{
+                .length = opts.trail_length,
+                .interval_ticks = opts.trail_interval,
+            });
+            trails->record(state);
+            std::cout << "Trails: " << opts.trail_length << " samples every " << opts.trail_interval << " ticks, "
+                      << trails->memory_bytes() / 1024 << " KiB for " << trails->bodies() << " bodies" << std::endl;
+        }
     }
 
     ~Sim() {}
@@ -155,6 +264,9 @@ public:
             if (updates_this_frame >= panic_update_cap)
                 lag = std::chrono::nanoseconds{0}; // drop excess lag
 
+            if (updates_this_frame && running)
+                pick_input();
+
             if (has_ticked && running) {
                 const double alpha = static_cast<double>(lag.count())
                                    / static_cast<double>(tick_interval().count());
@@ -164,7 +276,16 @@ public:
 
             auto now = clock::now();
             if (now - last_stats_time >= std::chrono::seconds{1}) {
-                std::cout << "TPS: " << tick_counter << " | FPS: " << render_counter << std::endl;
+                std::cout << "TPS: " << tick_counter << " | FPS: " << render_counter
+                          << " | drawn: " << batch.visible() << " in " << batch.prepare_ns() / 1000 << "us";
+                print_light_stats(lights.stats());
+                if (trails)
+                    print_trail_stats(*trails);
+                if (state.domains)
+                    print_domain_stats(state.domains->stats());
+                if (state.opening_angle > 0.0f)
+                    print_octree_stats(state.spatial_index().stats(), octree_rebuilds_seen);
+                std::cout << std::endl;
                 tick_counter = 0;
                 render_counter = 0;
                 last_stats_time = now;
@@ -178,6 +299,31 @@ public:
         }
     }
 
+    // Fixed-step recording: simulated time advances `frame_dt` per frame regardless of
+    // how long ticking and rendering take on the wall clock
+    void run_offscreen(std::uint32_t frames, double frame_dt)
+    {
+        using clock = std::chrono::steady_clock;
+        const auto start = clock::now();
+
+        double lag = 0.0;
+        for (std::uint32_t f=0; f<frames; ++f) {
+            lag += frame_dt;
+            while (lag >= fixed_dt) {
+                tick(static_cast<float>(fixed_dt));
+                lag -= fixed_dt;
+            }
+            render(static_cast<float>(lag / fixed_dt));
+        }
+        recorder->finish();
+
+        const double secs = std::chrono::duration<double>(clock::now() - start).count();
+        std::cout << "Recorded " << recorder->frames_written() << " frames in " << secs << " s ("
+                  << recorder->frames_written() / secs << " fps)" << std::endl;
+        if (const std::uint64_t failed = recorder->frames_failed())
+            std::cerr << "Failed to write " << failed << " of " << frames << " frames" << std::endl;
+    }
+
     static void setup_window(GLFWwindow* window)
     {
         int fbWidth, fbHeight;
@@ -187,6 +333,11 @@ public:
         glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
         glfwSwapInterval(1); // v-sync
 
+        setup_gl();
+    }
+
+    static void setup_gl()
+    {
         // z-buffer depth test
         glEnable(GL_DEPTH_TEST);
 
@@ -203,21 +354,58 @@ public:
 private:
     void tick(float dt)
     {
-        glfwPollEvents();
-        if (glfwWindowShouldClose(window) || glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-            stop();
-            return;
+        if (window) {
+            glfwPollEvents();
+            if (glfwWindowShouldClose(window) || glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+                stop();
+                return;
+            }
+            cam.keyInput(window, dt);
         }
-        cam.keyInput(window, dt);
 
         state.swap();
         // physics
 
         state.tick(dt);
+        ++ticks_done;
+        if (trails)
+            trails->record(state);
+    }
+
+    // left click selects the body under the crosshair and reports its surroundings
+    void pick_input()
+    {
+        const bool pressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+        const bool clicked = pressed && !pick_held;
+        pick_held = pressed;
+        if (!clicked)
+            return;
+
+        queries.publish(state, ticks_done);
+        const std::shared_ptr<const SpatialSnapshot> snap = queries.snapshot();
+
+        const std::optional<RayHit> hit = snap->raycast(Ray{cam.position, cam.front});
+        if (!hit) {
+            std::cout << "Picked nothing" << std::endl;
+            return;
+        }
+
+        constexpr float kNeighbourhood = 5.0f;
+        const glm::vec3 pos = state.transforms[state.index_of[hit->id]].pos;
+        Neighbour nearest[2];
+        snap->nearest(pos, nearest);
+        std::cout << "Picked body " << hit->id << " at distance " << hit->t
+                  << " | bodies within " << kNeighbourhood << ": " << snap->count_within_radius(pos, kNeighbourhood);
+        if (nearest[1].id != kNoBody)
+            std::cout << " | nearest: " << nearest[1].id << " at " << std::sqrt(nearest[1].dist_sq);
+        std::cout << std::endl;
     }
 
     void render(float alpha)
     {
+        if (recorder)
+            recorder->bind();
+
         glClearColor(0.05f, 0.07f, 0.12f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -228,23 +416,52 @@ private:
         shader_program.set_mat4("u_vp", vp);
 
         shader_program.set_vec3("u_view_pos", cam.position);
-        for (const auto& model : state.models) {
-            if (model->is_light_source) {
-                glm::vec3 pos = glm::mix(state.prev_tfs[model->idx].pos, state.transforms[model->idx].pos, alpha);
-                shader_program.set_vec3("u_light_pos", pos);
-            }
-        }
 
-        for (const auto& model : state.models) {
-            const Transform tf = interpolate(state.prev_tfs[model->idx], state.transforms[model->idx], alpha);
-            shader_program.set_mat4("u_model", tf.to_model_mat4());
-            shader_program.set_vec3("u_albedo", colours[model->idx]);
-            shader_program.set_bool("u_enable_light", !model->is_light_source);
+        lights.prepare(state, alpha, view);
+        lights.bind(shader_program);
 
-            model->draw();
-        }
+        batch.prepare(state, alpha, vp);
+        batch.draw(state.meshes);
+        if (trails)
+            trails->draw(vp);
+        lights.end_frame();
 
-        glfwSwapBuffers(window);
+        if (recorder)
+            recorder->capture();
+        else
+            glfwSwapBuffers(window);
+    }
+
+    static void print_domain_stats(const DomainStats& stats)
+    {
+        std::cout << " | domains:";
+        for (std::size_t d=0; d<stats.counts.size(); ++d)
+            std::cout << ' ' << stats.counts[d] << '@' << stats.work_ns[d] / 1000 << "us";
+        std::cout << " | migrated: " << stats.migrated;
+        if (stats.resplit)
+            std::cout << " (re-split)";
+    }
+
+    static void print_light_stats(const ClusterStats& stats)
+    {
+        std::cout << " | lights: " << stats.lights << " in " << stats.assignments << " cluster slots";
+        if (stats.dropped)
+            std::cout << " (" << stats.dropped << " dropped)";
+        std::cout << ", " << stats.build_ns / 1000 << "us";
+    }
+
+    static void print_trail_stats(const OrbitTrails& trails)
+    {
+        std::cout << " | trails: " << trails.memory_bytes() / 1024 << " KiB";
+    }
+
+    // `rebuilds_seen` is the count at the previous report, so the line shows rebuilds per interval
+    static void print_octree_stats(const OctreeStats& stats, std::uint32_t& rebuilds_seen)
+    {
+        std::cout << " | octree: " << stats.nodes << " nodes, refit " << stats.refit_ns / 1000 << "us ("
+                  << stats.reinserted << " moved), build " << stats.build_ns / 1000 << "us, "
+                  << stats.rebuilds - rebuilds_seen << " rebuilds";
+        rebuilds_seen = stats.rebuilds;
     }
 
     constexpr std::chrono::nanoseconds tick_interval() const
@@ -254,8 +471,67 @@ private:
     }
 };
 
-int main()
+namespace {
+const char* find_arg(int argc, char** argv, std::string_view name)
+{
+    for (int i=1; i+1<argc; ++i) {
+        if (std::string_view(argv[i]) == name)
+            return argv[i + 1];
+    }
+    return nullptr;
+}
+
+// --domains N : split physics over N local processes (Linux only)
+// --reorder K : sort bodies along a Hilbert curve every K ticks
+// --theta T   : Barnes-Hut opening angle over the shared octree, or over other
+//               domains' summaries with --domains; 0 = exact pair sum
+// --scene S   : solar | planets | plummer | hernquist | galaxy | cube
+// --bodies N  : body count for generated scenes
+// --seed S    : generator seed
+// --lights N  : also make N of the scene's bodies light sources
+// --trails L  : draw orbit trails of L samples, one every --trail-interval K ticks (default 4)
+// --record DIR : render headless (EGL) into DIR instead of opening a window
+// --frames N / --frame-dt S / --format png|raw / --width W / --height H : recording setup
+SimOptions parse_options(int argc, char** argv)
+{
+    SimOptions opts;
+    if (const char* v = find_arg(argc, argv, "--domains")) opts.num_domains = static_cast<std::uint32_t>(std::stoul(v));
+    if (const char* v = find_arg(argc, argv, "--reorder")) opts.reorder_interval = static_cast<std::uint32_t>(std::stoul(v));
+    if (const char* v = find_arg(argc, argv, "--theta"))   opts.opening_angle = std::stof(v);
+    if (const char* v = find_arg(argc, argv, "--scene"))   opts.scene = v;
+    if (const char* v = find_arg(argc, argv, "--bodies"))  opts.scene_bodies = std::stoull(v);
+    if (const char* v = find_arg(argc, argv, "--seed"))    opts.seed = std::stoull(v);
+    if (const char* v = find_arg(argc, argv, "--lights"))  opts.emitters = static_cast<std::uint32_t>(std::stoul(v));
+    if (const char* v = find_arg(argc, argv, "--trails"))  opts.trail_length = static_cast<std::uint32_t>(std::stoul(v));
+    if (const char* v = find_arg(argc, argv, "--trail-interval")) opts.trail_interval = static_cast<std::uint32_t>(std::stoul(v));
+
+    if (const char* v = find_arg(argc, argv, "--record"))   opts.record_dir = v;
+    if (const char* v = find_arg(argc, argv, "--frames"))   opts.record_frames = static_cast<std::uint32_t>(std::stoul(v));
+    if (const char* v = find_arg(argc, argv, "--frame-dt")) opts.frame_dt = std::stod(v);
+    if (const char* v = find_arg(argc, argv, "--width"))    opts.width = static_cast<std::uint32_t>(std::stoul(v));
+    if (const char* v = find_arg(argc, argv, "--height"))   opts.height = static_cast<std::uint32_t>(std::stoul(v));
+    if (const char* v = find_arg(argc, argv, "--format"))
+        opts.image_format = std::string_view(v) == "raw" ? ImageFormat::Raw : ImageFormat::Png;
+
+    if (!(opts.frame_dt > 0.0))
+        throw std::runtime_error(std::format("--frame-dt must be positive, got {}", opts.frame_dt));
+    return opts;
+}
+}
+
+int main(int argc, char** argv)
 try {
+    const SimOptions opts = parse_options(argc, argv);
+
+    if (!opts.record_dir.empty()) {
+        HeadlessContext context;
+        Sim::setup_gl();
+
+        Sim sim(nullptr, opts);
+        sim.run_offscreen(opts.record_frames, opts.frame_dt);
+        return EXIT_SUCCESS;
+    }
+
     GLFWwindow* window = create_window();
     glfwMakeContextCurrent(window);
 
@@ -266,7 +542,7 @@ try {
 
     Sim::setup_window(window);
 
-    Sim sim(window, 60, 144);
+    Sim sim(window, opts);
     sim.run();
 
     glfwDestroyWindow(window);
@@ -2,6 +2,8 @@
 
 #include <stddef.h>
 
+#include <utility>
+
 #include <glad/glad.h>
 #include <glm/vec3.hpp>
 
@@ -37,9 +39,28 @@ Mesh::Mesh(const Vertex* vertices,
 
 Mesh::~Mesh()
 {
-    glDeleteVertexArrays(1, &vao);
-    glDeleteBuffers(1, &vbo);
-    glDeleteBuffers(1, &ebo);
+    if (vao) glDeleteVertexArrays(1, &vao);
+    if (vbo) glDeleteBuffers(1, &vbo);
+    if (ebo) glDeleteBuffers(1, &ebo);
+}
+
+Mesh::Mesh(Mesh&& other) noexcept
+    : vao(std::exchange(other.vao, 0)),
+      vbo(std::exchange(other.vbo, 0)),
+      ebo(std::exchange(other.ebo, 0)),
+      index_count(std::exchange(other.index_count, 0))
+{}
+
+Mesh& Mesh::operator=(Mesh&& other) noexcept
+{
+    if (this != &other) {
+        this->~Mesh();
+        vao = std::exchange(other.vao, 0);
+        vbo = std::exchange(other.vbo, 0);
+        ebo = std::exchange(other.ebo, 0);
+        index_count = std::exchange(other.index_count, 0);
+    }
+    return *this;
 }
 
 void Mesh::draw() const
@@ -50,3 +71,13 @@ void Mesh::draw() const
                    GL_UNSIGNED_INT,
                    nullptr);
 }
+
+void Mesh::draw_instanced(std::uint32_t instances) const
+{
+    glBindVertexArray(vao);
+    glDrawElementsInstanced(GL_TRIANGLES,
+                            static_cast<GLsizei>(index_count),
+                            GL_UNSIGNED_INT,
+                            nullptr,
+                            static_cast<GLsizei>(instances));
+}
@@ -1,6 +1,6 @@
 #include "models.hpp"
 
-#include <memory>
+#include <iterator>
 #include <vector>
 
 #include <glm/trigonometric.hpp>
@@ -32,10 +32,11 @@ constexpr GLuint cube_indices[36] = {
 };
 }
 
-Cube::Cube(std::uint32_t idx) noexcept
-        : Model(cube_vertices, std::size(cube_vertices),
-                cube_indices,  std::size(cube_indices),
-                idx, false) {}
+Mesh create_cube_mesh()
+{
+    return Mesh(cube_vertices, std::size(cube_vertices),
+                cube_indices,  std::size(cube_indices));
+}
 
 
 namespace
@@ -98,16 +99,7 @@ void generate_uv_sphere(float radius,
 }
 }
 
-Sphere::Sphere(std::uint32_t idx,
-               bool is_light_source,
-               std::vector<Vertex>& vertices,
-               std::vector<GLuint>& indices) noexcept
-            : Model(vertices.data(), vertices.size(),
-                    indices.data(),  indices.size(),
-                    idx, is_light_source) {}
-
-
-std::unique_ptr<Sphere> create_sphere(std::uint32_t idx, bool is_light_source)
+Mesh create_sphere_mesh()
 {
     std::vector<Vertex> vertices;
     std::vector<GLuint> indices;
@@ -115,5 +107,6 @@ std::unique_ptr<Sphere> create_sphere(std::uint32_t idx, bool is_light_source)
         1.0f, 36, 18,
         vertices, indices);
 
-    return std::make_unique<Sphere>(idx, is_light_source, vertices, indices);
+    return Mesh(vertices.data(), vertices.size(),
+                indices.data(),  indices.size());
 }
\ No newline at end of file
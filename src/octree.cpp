@@ -0,0 +1,453 @@
+#include "octree.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+
+#include "morton.hpp"
+#include "parallel.hpp"
+#include "radix_sort.hpp"
+#include "state.hpp"
+
+
+namespace
+{
+constexpr std::size_t kMinChunk = 1 << 14;
+constexpr std::size_t kMinLeafChunk = 1 << 10;
+
+using clock_type = std::chrono::steady_clock;
+
+std::uint64_t elapsed_ns(clock_type::time_point start)
+{
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count());
+}
+
+bool in_cell(const Octree::Node& n, const glm::vec3& p)
+{
+    const glm::vec3 d = p - n.centre;
+    return std::abs(d.x) <= n.half && std::abs(d.y) <= n.half && std::abs(d.z) <= n.half;
+}
+
+std::uint32_t octant_of(const Octree::Node& n, const glm::vec3& p)
+{
+    return (p.x >= n.centre.x ? 1u : 0u) | (p.y >= n.centre.y ? 2u : 0u) | (p.z >= n.centre.z ? 4u : 0u);
+}
+
+// centre of mass weight: mass when the law stores it, body count otherwise.
+// A template so the branch naming `mass` is discarded for massless props
+template <class Props>
+float aggregate_weight(const Props& aggregate, std::uint32_t total)
+{
+    if constexpr (has_field_v<Props, fields::Mass>)
+        return aggregate.mass;
+    else
+        return static_cast<float>(total);
+}
+
+float node_weight(const Octree::Node& n)
+{
+    return aggregate_weight(n.aggregate, n.total);
+}
+
+Octree::Node make_node(const glm::vec3& centre, float half, std::uint32_t parent, std::uint32_t depth)
+{
+    Octree::Node n{};
+    n.centre = centre;
+    n.half = half;
+    n.parent = parent;
+    n.first_child = Octree::kNone;
+    n.depth = depth;
+    return n;
+}
+}
+
+Octree::Octree(OctreeConfig config)
+    : cfg(config)
+{
+    cfg.leaf_capacity = std::max(cfg.leaf_capacity, 1u);
+    cfg.max_depth = std::clamp(cfg.max_depth, 1u, kMaxDepth);
+}
+
+void Octree::update(const State& state, TickArena& scratch)
+{
+    const std::size_t n = state.transforms.size();
+    if (!built || leaf_of.size() != n) {
+        rebuild(state, scratch);
+        return;
+    }
+    if (!dirty)
+        return;
+
+    const auto start = clock_type::now();
+    const Transform* tfs = state.transforms.data();
+
+    // fixed chunks, each listing its movers in room for the whole chunk from the worker's arena
+    const std::size_t num_chunks = std::clamp<std::size_t>((n + kMinChunk - 1) / kMinChunk, 1, default_pool().size());
+    const std::size_t step = (n + num_chunks - 1) / num_chunks;
+    movers.resize(num_chunks);
+    default_pool().run(num_chunks, [&](std::size_t c, unsigned worker) {
+        const std::size_t begin = std::min(n, c * step), end = std::min(n, begin + step);
+        std::uint32_t* list = scratch.local(worker).alloc_array<std::uint32_t>(end - begin);
+        std::size_t count = 0;
+        for (std::size_t i=begin; i<end; ++i) {
+            if (!in_cell(tree[leaf_of[i]], tfs[i].pos))
+                list[count++] = static_cast<std::uint32_t>(i);
+        }
+        movers[c] = {list, count};
+    });
+
+    std::uint32_t moved = 0;
+    for (const auto& list : movers) {
+        for (const std::uint32_t i : list) {
+            if (!in_cell(tree[0], tfs[i].pos)) {
+                rebuild(state, scratch);
+                return;
+            }
+        }
+        moved += static_cast<std::uint32_t>(list.size());
+    }
+
+    for (const auto& list : movers) {
+        for (const std::uint32_t i : list) {
+            const std::uint32_t from = leaf_of[i];
+            remove(i);
+            insert(i, tfs[i].pos, from, tfs);
+        }
+    }
+
+    refit(state);
+    if (degraded(n)) {
+        rebuild(state, scratch);
+        return;
+    }
+
+    dirty = false;
+    stats_.reinserted = moved;
+    stats_.nodes = static_cast<std::uint32_t>(tree.size());
+    stats_.refit_ns = elapsed_ns(start);
+}
+
+void Octree::rebuild(const State& state, TickArena& scratch)
+{
+    const auto start = clock_type::now();
+    const std::size_t n = state.transforms.size();
+
+    tree.clear();
+    slots.clear();
+    slot_waste = 0;
+    leaf_of.assign(n, kNone);
+    slot_of.assign(n, 0);
+    stats_.max_depth = 0;
+
+    glm::vec3 lo{std::numeric_limits<float>::max()};
+    glm::vec3 hi{std::numeric_limits<float>::lowest()};
+    for (const Transform& tf : state.transforms) {
+        lo = glm::min(lo, tf.pos);
+        hi = glm::max(hi, tf.pos);
+    }
+    if (n == 0)
+        lo = hi = glm::vec3{0};
+
+    // cubic root with some slack so bodies drifting outwards do not force rebuilds
+    const glm::vec3 ext = hi - lo;
+    const float half = std::max({ext.x, ext.y, ext.z, 1e-3f}) * 0.5f * 1.05f;
+    const glm::vec3 centre = (lo + hi) * 0.5f;
+    tree.push_back(make_node(centre, half, kNone, 0));
+
+    // keys quantise to 2^kMortonBits cells per axis over the root cube, matching its cells
+    const glm::vec3 cube_lo = centre - glm::vec3{half};
+    constexpr float kCells = static_cast<float>(1u << kMortonBits);
+    const glm::vec3 inv_extent{kCells / ((kCells - 1.0f) * 2.0f * half)};
+
+    keys.resize(n);
+    order.resize(n);
+    parallel_for(n, kMinChunk, [&](std::size_t begin, std::size_t end, unsigned) {
+        for (std::size_t i=begin; i<end; ++i) {
+            keys[i] = morton_key(state.transforms[i].pos, cube_lo, inv_extent);
+            order[i] = static_cast<std::uint32_t>(i);
+        }
+    });
+    radix_sort_pairs(keys, order, keys_tmp, order_tmp, &scratch.shared());
+
+    build_node(0, 0, n);
+
+    // a key cell can disagree with the float cell test on a boundary; fix those up now
+    const Transform* tfs = state.transforms.data();
+    for (std::size_t i=0; i<n; ++i) {
+        if (!in_cell(tree[leaf_of[i]], tfs[i].pos)) {
+            const std::uint32_t from = leaf_of[i];
+            remove(static_cast<std::uint32_t>(i));
+            insert(static_cast<std::uint32_t>(i), tfs[i].pos, from, tfs);
+        }
+    }
+
+    refit(state);
+
+    built = true;
+    dirty = false;
+    nodes_at_build = tree.size();
+    depth_at_build = stats_.max_depth;
+    empty_fraction_at_build = empty_fraction();
+    // incremental updates can split up to the node limit without reallocating,
+    // grown geometrically so small changes between rebuilds don't reallocate either
+    if (const std::size_t want = node_limit() + 8; tree.capacity() < want)
+        tree.reserve(std::max(want, tree.capacity() + tree.capacity() / 2));
+
+    ++stats_.rebuilds;
+    stats_.reinserted = 0;
+    stats_.nodes = static_cast<std::uint32_t>(tree.size());
+    stats_.build_ns = elapsed_ns(start);
+}
+
+// `order[begin, end)` holds the bodies of `node`, sorted by Morton key
+void Octree::build_node(std::uint32_t node, std::size_t begin, std::size_t end)
+{
+    const std::uint32_t depth = tree[node].depth;
+    const auto count = static_cast<std::uint32_t>(end - begin);
+    stats_.max_depth = std::max(stats_.max_depth, depth);
+
+    if (count <= cfg.leaf_capacity || depth >= kMortonBits || depth >= cfg.max_depth) {
+        const std::uint32_t capacity = std::max(cfg.leaf_capacity, count);
+        const std::uint32_t first = alloc_slots(capacity);
+        tree[node].begin = first;
+        tree[node].capacity = capacity;
+        for (std::uint32_t k=0; k<count; ++k) {
+            const std::uint32_t body = order[begin + k];
+            slots[first + k] = body;
+            leaf_of[body] = node;
+            slot_of[body] = first + k;
+        }
+        tree[node].count = count;
+        return;
+    }
+
+    const std::uint32_t first_child = add_children(node);
+    const std::uint32_t shift = 3 * (kMortonBits - 1 - depth);
+
+    std::size_t lo = begin;
+    for (std::uint32_t oct=0; oct<8; ++oct) {
+        const std::size_t hi = std::partition_point(
+            keys.begin() + lo, keys.begin() + end,
+            [&](std::uint32_t key) { return ((key >> shift) & 7u) <= oct; }) - keys.begin();
+        build_node(first_child + oct, lo, hi);
+        lo = hi;
+    }
+}
+
+std::uint32_t Octree::add_children(std::uint32_t node)
+{
+    const auto first = static_cast<std::uint32_t>(tree.size());
+    const glm::vec3 centre = tree[node].centre;
+    const float half = tree[node].half * 0.5f;
+    const std::uint32_t depth = tree[node].depth + 1;
+
+    for (std::uint32_t oct=0; oct<8; ++oct) {
+        const glm::vec3 offset{(oct & 1u) ? half : -half, (oct & 2u) ? half : -half, (oct & 4u) ? half : -half};
+        tree.push_back(make_node(centre + offset, half, node, depth));
+    }
+    tree[node].first_child = first;
+    stats_.max_depth = std::max(stats_.max_depth, depth);
+    return first;
+}
+
+std::uint32_t Octree::alloc_slots(std::uint32_t capacity)
+{
+    const auto first = static_cast<std::uint32_t>(slots.size());
+    slots.resize(slots.size() + capacity);
+    return first;
+}
+
+void Octree::remove(std::uint32_t body)
+{
+    Node& leaf = tree[leaf_of[body]];
+    const std::uint32_t last = leaf.begin + leaf.count - 1;
+    const std::uint32_t moved = slots[last];
+    slots[slot_of[body]] = moved;
+    slot_of[moved] = slot_of[body];
+    --leaf.count;
+    leaf_of[body] = kNone;
+}
+
+// climbs from `from` to the first cell containing `pos`, then descends to its leaf
+void Octree::insert(std::uint32_t body, const glm::vec3& pos, std::uint32_t from, const Transform* tfs)
+{
+    std::uint32_t node = from;
+    while (tree[node].parent != kNone && !in_cell(tree[node], pos))
+        node = tree[node].parent;
+
+    for (;;) {
+        if (tree[node].first_child != kNone) {
+            node = tree[node].first_child + octant_of(tree[node], pos);
+            continue;
+        }
+        if (tree[node].count < tree[node].capacity) {
+            push(node, body);
+            return;
+        }
+        if (tree[node].depth < cfg.max_depth && tree[node].count >= cfg.leaf_capacity)
+            split(node, tfs);
+        else
+            grow(node);
+    }
+}
+
+void Octree::push(std::uint32_t leaf, std::uint32_t body)
+{
+    Node& n = tree[leaf];
+    const std::uint32_t slot = n.begin + n.count++;
+    slots[slot] = body;
+    leaf_of[body] = leaf;
+    slot_of[body] = slot;
+}
+
+void Octree::split(std::uint32_t leaf, const Transform* tfs)
+{
+    split_scratch.assign(slots.begin() + tree[leaf].begin, slots.begin() + tree[leaf].begin + tree[leaf].count);
+    slot_waste += tree[leaf].capacity;
+    tree[leaf].count = 0;
+    tree[leaf].capacity = 0;
+
+    const std::uint32_t first = add_children(leaf);
+
+    std::uint32_t counts[8] = {};
+    for (const std::uint32_t body : split_scratch)
+        ++counts[octant_of(tree[leaf], tfs[body].pos)];
+    for (std::uint32_t oct=0; oct<8; ++oct) {
+        Node& child = tree[first + oct];
+        child.capacity = std::max(cfg.leaf_capacity, counts[oct]);
+        child.begin = alloc_slots(child.capacity);
+    }
+    for (const std::uint32_t body : split_scratch)
+        push(first + octant_of(tree[leaf], tfs[body].pos), body);
+}
+
+// moves a full leaf that may not split to a range twice its size at the end of `slots`
+void Octree::grow(std::uint32_t leaf)
+{
+    const std::uint32_t old_begin = tree[leaf].begin;
+    const std::uint32_t count = tree[leaf].count;
+    const std::uint32_t capacity = std::max(2 * tree[leaf].capacity, cfg.leaf_capacity);
+
+    const std::uint32_t first = alloc_slots(capacity);
+    for (std::uint32_t k=0; k<count; ++k) {
+        const std::uint32_t body = slots[old_begin + k];
+        slots[first + k] = body;
+        slot_of[body] = first + k;
+    }
+    slot_waste += tree[leaf].capacity;
+    tree[leaf].begin = first;
+    tree[leaf].capacity = capacity;
+}
+
+void Octree::refit(const State& state)
+{
+    const Transform* tfs = state.transforms.data();
+    const PhysicsProps* props = state.props.data();
+
+    std::atomic<std::uint32_t> num_leaves{0}, num_empty{0};
+    parallel_for(tree.size(), kMinLeafChunk, [&](std::size_t begin, std::size_t end, unsigned) {
+        std::uint32_t local_leaves = 0, local_empty = 0;
+        for (std::size_t k=begin; k<end; ++k) {
+            Node& n = tree[k];
+            if (n.first_child != kNone)
+                continue;
+
+            ++local_leaves;
+            n.total = n.count;
+            if (n.count == 0) {
+                ++local_empty;
+                continue;
+            }
+
+            glm::vec3 lo{std::numeric_limits<float>::max()};
+            glm::vec3 hi{std::numeric_limits<float>::lowest()};
+            glm::vec3 weighted{0};
+            float weight = 0.0f;
+            float reach = 0.0f;
+
+            n.aggregate = props[slots[n.begin]];
+            n.aggregate.vel = glm::vec3{0};
+            for (std::uint32_t s=n.begin; s<n.begin + n.count; ++s) {
+                const std::uint32_t body = slots[s];
+                const glm::vec3& pos = tfs[body].pos;
+                if (s != n.begin)
+                    n.aggregate.accumulate(props[body]);
+                lo = glm::min(lo, pos);
+                hi = glm::max(hi, pos);
+                reach = std::max(reach, tfs[body].scale);
+                weighted += mass_of(props[body]) * pos;
+                weight += mass_of(props[body]);
+            }
+            n.lo = lo;
+            n.hi = hi;
+            n.reach = reach;
+            n.com = weight > 0.0f ? weighted / weight : (lo + hi) * 0.5f;
+        }
+        num_leaves += local_leaves;
+        num_empty += local_empty;
+    });
+    leaves = num_leaves;
+    empty_leaves = num_empty;
+
+    // children always follow their parent, so a reverse sweep sees them first
+    for (std::size_t k=tree.size(); k-- > 0;) {
+        Node& n = tree[k];
+        if (n.first_child == kNone)
+            continue;
+
+        n.total = 0;
+        glm::vec3 lo{std::numeric_limits<float>::max()};
+        glm::vec3 hi{std::numeric_limits<float>::lowest()};
+        glm::vec3 weighted{0};
+        float weight = 0.0f;
+        float reach = 0.0f;
+
+        for (std::uint32_t oct=0; oct<8; ++oct) {
+            const Node& c = tree[n.first_child + oct];
+            if (c.total == 0)
+                continue;
+
+            if (n.total == 0)
+                n.aggregate = c.aggregate;
+            else
+                n.aggregate.accumulate(c.aggregate);
+            n.total += c.total;
+            lo = glm::min(lo, c.lo);
+            hi = glm::max(hi, c.hi);
+            reach = std::max(reach, c.reach);
+            weighted += node_weight(c) * c.com;
+            weight += node_weight(c);
+        }
+        if (n.total == 0)
+            continue;
+
+        n.lo = lo;
+        n.hi = hi;
+        n.reach = reach;
+        n.com = weight > 0.0f ? weighted / weight : (lo + hi) * 0.5f;
+    }
+}
+
+std::size_t Octree::node_limit() const
+{
+    return static_cast<std::size_t>(cfg.max_node_growth * static_cast<float>(std::max<std::size_t>(nodes_at_build, 64)));
+}
+
+float Octree::empty_fraction() const
+{
+    return leaves ? static_cast<float>(empty_leaves) / static_cast<float>(leaves) : 0.0f;
+}
+
+// relative to the last build: clustered scenes start with many empty leaves
+bool Octree::degraded(std::size_t num_bodies) const
+{
+    if (empty_fraction() > empty_fraction_at_build + cfg.max_empty_leaf_growth)
+        return true;
+    if (tree.size() > node_limit())
+        return true;
+    if (static_cast<float>(slot_waste) > cfg.max_slot_waste * static_cast<float>(num_bodies) + 8.0f * cfg.leaf_capacity)
+        return true;
+    return stats_.max_depth > depth_at_build + cfg.max_depth_growth;
+}
@@ -0,0 +1,96 @@
+#include "parallel.hpp"
+
+
+namespace
+{
+thread_local bool inside_pool_task = false;
+}
+
+ThreadPool::ThreadPool(unsigned num_threads)
+{
+    threads.reserve(num_threads > 0 ? num_threads - 1 : 0);
+    for (unsigned w=1; w<num_threads; ++w)
+        threads.emplace_back(&ThreadPool::worker_loop, this, w);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(mtx);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t : threads)
+        t.join();
+}
+
+void ThreadPool::run(std::size_t num_tasks, TaskRef fn)
+{
+    if (num_tasks == 0)
+        return;
+
+    std::unique_lock submit(submit_mtx, std::defer_lock);
+    if (threads.empty() || inside_pool_task || num_tasks == 1 || !submit.try_lock()) {
+        for (std::size_t task=0; task<num_tasks; ++task)
+            fn(task, 0);
+        return;
+    }
+
+    {
+        std::lock_guard lock(mtx);
+        job = &fn;
+        job_tasks = num_tasks;
+        next_task = 0;
+        finished_tasks = 0;
+        ++generation;
+    }
+    wake.notify_all();
+
+    drain(0);
+
+    std::unique_lock lock(mtx);
+    done.wait(lock, [&] { return finished_tasks == job_tasks; });
+    job = nullptr;
+}
+
+// Claims tasks of the current job until none are left
+void ThreadPool::drain(unsigned worker)
+{
+    inside_pool_task = true;
+
+    std::unique_lock lock(mtx);
+    while (job && next_task < job_tasks) {
+        const std::size_t task = next_task++;
+        const TaskRef fn = *job;
+        lock.unlock();
+
+        fn(task, worker);
+
+        lock.lock();
+        if (++finished_tasks == job_tasks)
+            done.notify_one();
+    }
+
+    inside_pool_task = false;
+}
+
+void ThreadPool::worker_loop(unsigned worker)
+{
+    std::uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock lock(mtx);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+        drain(worker);
+    }
+}
+
+ThreadPool& default_pool()
+{
+    static ThreadPool pool;
+    return pool;
+}
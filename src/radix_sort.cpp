@@ -0,0 +1,78 @@
+#include "radix_sort.hpp"
+
+#include <array>
+#include <cassert>
+#include <utility>
+
+#include "parallel.hpp"
+
+
+namespace
+{
+constexpr std::uint32_t kRadixBits = 8;
+constexpr std::uint32_t kBuckets = 1u << kRadixBits;
+constexpr std::size_t kMinChunk = 1 << 14;
+
+using Histogram = std::array<std::uint32_t, kBuckets>;
+}
+
+void radix_sort_pairs(std::vector<std::uint32_t>& keys,
+                      std::vector<std::uint32_t>& values,
+                      std::vector<std::uint32_t>& keys_tmp,
+                      std::vector<std::uint32_t>& values_tmp,
+                      std::pmr::memory_resource* scratch)
+{
+    assert(keys.size() == values.size());
+    const std::size_t n = keys.size();
+    if (n < 2)
+        return;
+
+    keys_tmp.resize(n);
+    values_tmp.resize(n);
+
+    // fixed chunking so that the histogram of chunk c always describes the same range
+    const std::size_t num_chunks = std::min<std::size_t>(default_pool().size(),
+                                                         (n + kMinChunk - 1) / kMinChunk);
+    const std::size_t step = (n + num_chunks - 1) / num_chunks;
+    std::pmr::vector<Histogram> hist(num_chunks, scratch);
+
+    for (std::uint32_t shift=0; shift<32; shift+=kRadixBits) {
+        default_pool().run(num_chunks, [&](std::size_t c, unsigned) {
+            Histogram& h = hist[c];
+            h.fill(0);
+            const std::size_t end = std::min(n, (c + 1) * step);
+            for (std::size_t i=c*step; i<end; ++i)
+                ++h[(keys[i] >> shift) & (kBuckets - 1)];
+        });
+
+        // exclusive scan, bucket-major then chunk-major keeps the sort stable
+        std::uint32_t running = 0;
+        bool single_bucket = false;
+        for (std::uint32_t b=0; b<kBuckets; ++b) {
+            std::uint32_t bucket_total = 0;
+            for (Histogram& h : hist) {
+                const std::uint32_t count = h[b];
+                h[b] = running;
+                running += count;
+                bucket_total += count;
+            }
+            if (bucket_total == n)
+                single_bucket = true;
+        }
+        if (single_bucket)
+            continue;
+
+        default_pool().run(num_chunks, [&](std::size_t c, unsigned) {
+            Histogram& offsets = hist[c];
+            const std::size_t end = std::min(n, (c + 1) * step);
+            for (std::size_t i=c*step; i<end; ++i) {
+                const std::uint32_t dst = offsets[(keys[i] >> shift) & (kBuckets - 1)]++;
+                keys_tmp[dst]   = keys[i];
+                values_tmp[dst] = values[i];
+            }
+        });
+
+        std::swap(keys, keys_tmp);
+        std::swap(values, values_tmp);
+    }
+}
@@ -0,0 +1,372 @@
+#include "render_batch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+
+#include <glad/glad.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define SPACESIM_SSE 1
+#endif
+
+#include "parallel.hpp"
+#include "state.hpp"
+
+
+namespace
+{
+constexpr std::size_t kChunk = 4096; // models per task, fixed so both passes agree
+constexpr GLuint64 kFenceTimeoutNs = 1'000'000'000ull;
+
+using Planes = std::array<glm::vec4, 6>;
+
+// Gribb-Hartmann: world-space frustum planes with normalised xyz, pointing inwards
+Planes frustum_planes(const glm::mat4& vp)
+{
+    const auto row = [&](int r) { return glm::vec4{vp[0][r], vp[1][r], vp[2][r], vp[3][r]}; };
+    const glm::vec4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+
+    Planes planes = {r3 + r0, r3 - r0, r3 + r1, r3 - r1, r3 + r2, r3 - r2};
+    for (glm::vec4& p : planes)
+        p /= glm::length(glm::vec3{p.x, p.y, p.z});
+    return planes;
+}
+
+bool sphere_visible(const Planes& planes, const glm::vec3& c, float radius)
+{
+    for (const glm::vec4& p : planes) {
+        if (p.x * c.x + p.y * c.y + p.z * c.z + p.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+glm::vec4 instance_colour(const State& s, const Model& m)
+{
+    const glm::vec3& c = s.albedo[m.idx];
+    return {c.x, c.y, c.z, m.is_light_source ? 0.0f : 1.0f};
+}
+
+void write_one(const State& s, const Model& m, float alpha, InstanceData& out)
+{
+    const std::uint32_t i = s.index_of[m.idx];
+    out.model = interpolate(s.prev_tfs[i], s.transforms[i], alpha).to_model_mat4();
+    out.colour = instance_colour(s, m);
+}
+
+#if defined(SPACESIM_SSE)
+
+// Transform viewed as 8 floats: pos xyz, the quaternion, scale
+static_assert(sizeof(Transform) == 8 * sizeof(float));
+static_assert(offsetof(Transform, pos) == 0 && offsetof(Transform, scale) == 7 * sizeof(float));
+
+constexpr std::size_t quat_lane(std::size_t member_offset)
+{
+    return (offsetof(Transform, rot) + member_offset) / sizeof(float);
+}
+constexpr std::size_t kQx = quat_lane(offsetof(glm::quat, x));
+constexpr std::size_t kQy = quat_lane(offsetof(glm::quat, y));
+constexpr std::size_t kQz = quat_lane(offsetof(glm::quat, z));
+constexpr std::size_t kQw = quat_lane(offsetof(glm::quat, w));
+
+// 4 transforms as 8 SoA registers, one per float of Transform
+struct Lanes {
+    __m128 v[8];
+};
+
+Lanes load_transposed(const Transform* const tf[4])
+{
+    Lanes l;
+    __m128 lo[4], hi[4];
+    for (int k=0; k<4; ++k) {
+        const float* f = reinterpret_cast<const float*>(tf[k]);
+        lo[k] = _mm_loadu_ps(f);
+        hi[k] = _mm_loadu_ps(f + 4);
+    }
+    _MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+    _MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+    for (int k=0; k<4; ++k) {
+        l.v[k] = lo[k];
+        l.v[k + 4] = hi[k];
+    }
+    return l;
+}
+
+__m128 lerp4(__m128 a, __m128 b, __m128 t)
+{
+    return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+// mask of lanes whose quaternion is exactly (0, 0, 0, 1)
+int identity_mask(const Lanes& l)
+{
+    const __m128 zero = _mm_setzero_ps();
+    __m128 m = _mm_cmpeq_ps(l.v[kQw], _mm_set1_ps(1.0f));
+    m = _mm_and_ps(m, _mm_cmpeq_ps(l.v[kQx], zero));
+    m = _mm_and_ps(m, _mm_cmpeq_ps(l.v[kQy], zero));
+    m = _mm_and_ps(m, _mm_cmpeq_ps(l.v[kQz], zero));
+    return _mm_movemask_ps(m);
+}
+
+// streams one column for each of the 4 instances
+void store_column(float* const dst[4], int col, __m128 x, __m128 y, __m128 z, __m128 w)
+{
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    _mm_stream_ps(dst[0] + 4 * col, x);
+    _mm_stream_ps(dst[1] + 4 * col, y);
+    _mm_stream_ps(dst[2] + 4 * col, z);
+    _mm_stream_ps(dst[3] + 4 * col, w);
+}
+
+void write_four(const State& s, const std::uint32_t* model_idx, float alpha, InstanceData* out)
+{
+    const Model* m[4];
+    const Transform* prev[4];
+    const Transform* curr[4];
+    float* dst[4];
+    for (int k=0; k<4; ++k) {
+        m[k] = &s.models[model_idx[k]];
+        const std::uint32_t i = s.index_of[m[k]->idx];
+        prev[k] = &s.prev_tfs[i];
+        curr[k] = &s.transforms[i];
+        dst[k] = reinterpret_cast<float*>(&out[k]);
+    }
+
+    const Lanes a = load_transposed(prev);
+    const Lanes b = load_transposed(curr);
+    const __m128 t = _mm_set1_ps(alpha);
+    const __m128 zero = _mm_setzero_ps();
+
+    const __m128 scale = lerp4(a.v[7], b.v[7], t);
+    __m128 c0x, c0y, c0z, c1x, c1y, c1z, c2x, c2y, c2z;
+
+    if ((identity_mask(a) & identity_mask(b)) == 0xF) {
+        c0x = scale; c0y = zero;  c0z = zero;
+        c1x = zero;  c1y = scale; c1z = zero;
+        c2x = zero;  c2y = zero;  c2z = scale;
+    } else {
+        // nlerp along the shorter arc
+        const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.v[kQx], b.v[kQx]), _mm_mul_ps(a.v[kQy], b.v[kQy])),
+                                      _mm_add_ps(_mm_mul_ps(a.v[kQz], b.v[kQz]), _mm_mul_ps(a.v[kQw], b.v[kQw])));
+        const __m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, zero), _mm_set1_ps(-0.0f));
+
+        __m128 x = lerp4(a.v[kQx], _mm_xor_ps(b.v[kQx], flip), t);
+        __m128 y = lerp4(a.v[kQy], _mm_xor_ps(b.v[kQy], flip), t);
+        __m128 z = lerp4(a.v[kQz], _mm_xor_ps(b.v[kQz], flip), t);
+        __m128 w = lerp4(a.v[kQw], _mm_xor_ps(b.v[kQw], flip), t);
+
+        const __m128 len_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                                         _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+        // fold 2 / |q|^2 and the scale into one factor, saves normalising q
+        const __m128 k = _mm_div_ps(_mm_mul_ps(_mm_set1_ps(2.0f), scale), len_sq);
+
+        const __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        const __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        const __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+        c0x = _mm_sub_ps(scale, _mm_mul_ps(k, _mm_add_ps(yy, zz)));
+        c0y = _mm_mul_ps(k, _mm_add_ps(xy, wz));
+        c0z = _mm_mul_ps(k, _mm_sub_ps(xz, wy));
+        c1x = _mm_mul_ps(k, _mm_sub_ps(xy, wz));
+        c1y = _mm_sub_ps(scale, _mm_mul_ps(k, _mm_add_ps(xx, zz)));
+        c1z = _mm_mul_ps(k, _mm_add_ps(yz, wx));
+        c2x = _mm_mul_ps(k, _mm_add_ps(xz, wy));
+        c2y = _mm_mul_ps(k, _mm_sub_ps(yz, wx));
+        c2z = _mm_sub_ps(scale, _mm_mul_ps(k, _mm_add_ps(xx, yy)));
+    }
+
+    store_column(dst, 0, c0x, c0y, c0z, zero);
+    store_column(dst, 1, c1x, c1y, c1z, zero);
+    store_column(dst, 2, c2x, c2y, c2z, zero);
+    store_column(dst, 3, lerp4(a.v[0], b.v[0], t), lerp4(a.v[1], b.v[1], t), lerp4(a.v[2], b.v[2], t),
+                 _mm_set1_ps(1.0f));
+
+    for (int k=0; k<4; ++k) {
+        const glm::vec4 c = instance_colour(s, *m[k]);
+        _mm_stream_ps(dst[k] + 16, _mm_setr_ps(c.x, c.y, c.z, c.w));
+    }
+}
+
+#endif
+
+void write_instances(const State& s, const std::uint32_t* model_idx, std::size_t count,
+                     float alpha, InstanceData* out)
+{
+    std::size_t k = 0;
+#if defined(SPACESIM_SSE)
+    for (; k + 4 <= count; k += 4)
+        write_four(s, model_idx + k, alpha, out + k);
+    _mm_sfence(); // streaming stores must land before the draw is issued
+#endif
+    for (; k < count; ++k)
+        write_one(s, s.models[model_idx[k]], alpha, out[k]);
+}
+
+void wait_fence(GLsync& fence)
+{
+    if (!fence)
+        return;
+    GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, kFenceTimeoutNs);
+    while (status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(fence, 0, kFenceTimeoutNs);
+    glDeleteSync(fence);
+    fence = nullptr;
+    if (status == GL_WAIT_FAILED)
+        throw std::runtime_error("waiting for instance buffer fence failed");
+}
+}
+
+RenderBatch::RenderBatch(std::uint32_t ring_size)
+    : ring_size(std::max(ring_size, 1u)),
+      fences(this->ring_size, nullptr)
+{
+    GLint align = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &align);
+    ssbo_align = std::max<std::size_t>(static_cast<std::size_t>(align), 16);
+}
+
+RenderBatch::~RenderBatch()
+{
+    release();
+}
+
+void RenderBatch::release()
+{
+    for (GLsync& f : fences) {
+        if (f) glDeleteSync(f);
+        f = nullptr;
+    }
+    if (buffer) {
+        glUnmapNamedBuffer(buffer);
+        glDeleteBuffers(1, &buffer);
+    }
+    buffer = 0;
+    mapped = nullptr;
+    region_bytes = 0;
+}
+
+void RenderBatch::reserve(std::size_t bytes)
+{
+    if (bytes <= region_bytes)
+        return;
+
+    for (GLsync& f : fences)
+        wait_fence(f);
+    const std::size_t grown = std::max(bytes, region_bytes + region_bytes / 2);
+    release();
+
+    region_bytes = (grown + ssbo_align - 1) / ssbo_align * ssbo_align;
+    const auto total = static_cast<GLsizeiptr>(region_bytes * ring_size);
+
+    constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, total, nullptr, flags);
+    mapped = static_cast<std::byte*>(glMapNamedBufferRange(buffer, 0, total, flags));
+    if (!mapped)
+        throw std::runtime_error("failed to map instance buffer");
+}
+
+void RenderBatch::prepare(const State& state, float alpha, const glm::mat4& vp)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    const std::size_t n = state.models.size();
+    const std::size_t num_meshes = state.meshes.size();
+    const std::size_t chunks = (n + kChunk - 1) / kChunk;
+    const Planes planes = frustum_planes(vp);
+
+    culled.resize(n);
+    visible_models.resize(n);
+    chunk_counts.assign(chunks * num_meshes, 0);
+    chunk_starts.resize(chunks * num_meshes);
+
+    // pass 1: cull, then group each chunk's survivors by mesh in place
+    ThreadPool& pool = default_pool();
+    pool.run(chunks, [&](std::size_t c, unsigned) {
+        const std::size_t begin = c * kChunk;
+        const std::size_t end = std::min(n, begin + kChunk);
+        std::uint32_t* counts = &chunk_counts[c * num_meshes];
+
+        std::size_t kept = begin;
+        for (std::size_t k=begin; k<end; ++k) {
+            const Model& m = state.models[k];
+            const std::uint32_t i = state.index_of[m.idx];
+            const Transform& a = state.prev_tfs[i];
+            const Transform& b = state.transforms[i];
+            const glm::vec3 centre = a.pos + alpha * (b.pos - a.pos);
+            if (!sphere_visible(planes, centre, std::max(a.scale, b.scale)))
+                continue;
+            culled[kept++] = static_cast<std::uint32_t>(k);
+            ++counts[m.mesh_id];
+        }
+
+        std::uint32_t* starts = &chunk_starts[c * num_meshes];
+        std::uint32_t run = 0;
+        for (std::size_t mesh=0; mesh<num_meshes; ++mesh) {
+            starts[mesh] = run;
+            run += counts[mesh];
+        }
+        for (std::size_t k=begin; k<kept; ++k)
+            visible_models[begin + starts[state.models[culled[k]].mesh_id]++] = culled[k];
+    });
+
+    // place mesh groups (aligned for binding) and each chunk inside its group
+    mesh_offsets.resize(num_meshes);
+    mesh_counts.assign(num_meshes, 0);
+    std::size_t bytes = 0;
+    for (std::size_t mesh=0; mesh<num_meshes; ++mesh) {
+        mesh_offsets[mesh] = bytes;
+        for (std::size_t c=0; c<chunks; ++c) {
+            std::uint32_t& count = chunk_counts[c * num_meshes + mesh];
+            const std::uint32_t first = mesh_counts[mesh];
+            mesh_counts[mesh] += count;
+            count = first; // now the chunk's first instance within the group
+        }
+        bytes += mesh_counts[mesh] * sizeof(InstanceData);
+        bytes = (bytes + ssbo_align - 1) / ssbo_align * ssbo_align;
+    }
+    num_visible = 0;
+    for (const std::uint32_t count : mesh_counts)
+        num_visible += count;
+
+    reserve(std::max<std::size_t>(bytes, ssbo_align));
+    wait_fence(fences[region]);
+    std::byte* base = mapped + region * region_bytes;
+
+    // pass 2: interpolate and write; chunk_starts now hold each group's end within the chunk
+    pool.run(chunks, [&](std::size_t c, unsigned) {
+        const std::size_t begin = c * kChunk;
+        std::size_t slice = begin;
+        for (std::size_t mesh=0; mesh<num_meshes; ++mesh) {
+            const std::size_t end = begin + chunk_starts[c * num_meshes + mesh];
+            auto* out = reinterpret_cast<InstanceData*>(base + mesh_offsets[mesh])
+                      + chunk_counts[c * num_meshes + mesh];
+            write_instances(state, &visible_models[slice], end - slice, alpha, out);
+            slice = end;
+        }
+    });
+
+    last_prepare_ns = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+void RenderBatch::draw(const ObjectPool<Mesh>& meshes)
+{
+    const GLintptr region_offset = static_cast<GLintptr>(region * region_bytes);
+    for (std::size_t mesh=0; mesh<mesh_counts.size(); ++mesh) {
+        const std::uint32_t count = mesh_counts[mesh];
+        if (count == 0)
+            continue;
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, buffer,
+                          region_offset + static_cast<GLintptr>(mesh_offsets[mesh]),
+                          static_cast<GLsizeiptr>(count * sizeof(InstanceData)));
+        meshes[mesh].draw_instanced(count);
+    }
+
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % ring_size;
+}
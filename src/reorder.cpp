@@ -0,0 +1,70 @@
+#include "reorder.hpp"
+
+#include <limits>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include "domain.hpp"
+#include "morton.hpp"
+#include "parallel.hpp"
+#include "radix_sort.hpp"
+#include "state.hpp"
+
+
+namespace
+{
+constexpr std::size_t kMinChunk = 1 << 14;
+}
+
+template <class T>
+void BodyReorderer::permute(std::vector<T>& data, std::vector<T>& scratch) const
+{
+    scratch.resize(data.size());
+    parallel_for(data.size(), kMinChunk, [&](std::size_t begin, std::size_t end, unsigned) {
+        for (std::size_t i=begin; i<end; ++i)
+            scratch[i] = data[order[i]];
+    });
+    std::swap(data, scratch);
+}
+
+void BodyReorderer::apply(State& state, SpaceCurve curve)
+{
+    const std::size_t n = state.transforms.size();
+    if (n < 2)
+        return;
+
+    glm::vec3 lo{std::numeric_limits<float>::max()};
+    glm::vec3 hi{std::numeric_limits<float>::lowest()};
+    for (const Transform& tf : state.transforms) {
+        lo = glm::min(lo, tf.pos);
+        hi = glm::max(hi, tf.pos);
+    }
+    const glm::vec3 inv_extent = 1.0f / glm::max(hi - lo, glm::vec3{1e-6f});
+
+    keys.resize(n);
+    order.resize(n);
+    parallel_for(n, kMinChunk, [&](std::size_t begin, std::size_t end, unsigned) {
+        for (std::size_t i=begin; i<end; ++i) {
+            const glm::vec3& pos = state.transforms[i].pos;
+            keys[i] = curve == SpaceCurve::Morton ? morton_key(pos, lo, inv_extent)
+                                                  : hilbert_key(pos, lo, inv_extent);
+            order[i] = static_cast<std::uint32_t>(i);
+        }
+    });
+    radix_sort_pairs(keys, order, keys_tmp, order_tmp, &state.arena.shared());
+
+    permute(state.transforms, tf_scratch);
+    if (state.prev_tfs.size() == n)
+        permute(state.prev_tfs, tf_scratch);
+    permute(state.props, props_scratch);
+    permute(state.ids, id_scratch);
+
+    parallel_for(n, kMinChunk, [&](std::size_t begin, std::size_t end, unsigned) {
+        for (std::size_t i=begin; i<end; ++i)
+            state.index_of[state.ids[i]] = static_cast<std::uint32_t>(i);
+    });
+
+    if (state.domains)
+        state.domains->on_reorder(order);
+}
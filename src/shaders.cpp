@@ -9,12 +9,13 @@
 #include <glm/gtc/type_ptr.hpp>
 
 
-ShaderProgram::ShaderProgram(GLuint prog_id) : id(prog_id)
+ShaderProgram::ShaderProgram(GLuint prog_id, std::span<const std::string> names)
+    : id(prog_id), names(names), uniforms(names.size())
 {
-    for (std::size_t i=0; i<kNumUniforms; ++i) {
-        uniforms[i] = glGetUniformLocation(id, uniform_names[i].data());
+    for (std::size_t i=0; i<names.size(); ++i) {
+        uniforms[i] = glGetUniformLocation(id, names[i].data());
         if (uniforms[i] == -1)
-            std::cerr << "Warning: No uniform found with name `" << uniform_names[i] << "`\n";
+            std::cerr << "Warning: No uniform found with name `" << names[i] << "`\n";
     }
 }
 
@@ -29,15 +30,30 @@ void ShaderProgram::set_mat4(std::string_view u_name, const glm::mat4& mat) cons
     GLint handle = uniform_location(u_name);
     glUniformMatrix4fv(handle, 1, GL_FALSE, glm::value_ptr(mat));
 }
+void ShaderProgram::set_vec2(std::string_view u_name, const glm::vec2& vec) const
+{
+    GLint handle = uniform_location(u_name);
+    glUniform2fv(handle, 1, glm::value_ptr(vec));
+}
 void ShaderProgram::set_vec3(std::string_view u_name, const glm::vec3& vec) const
 {
     GLint handle = uniform_location(u_name);
     glUniform3fv(handle, 1, glm::value_ptr(vec));
 }
-void ShaderProgram::set_bool(std::string_view u_name, const bool b) const
+void ShaderProgram::set_vec4(std::string_view u_name, const glm::vec4& vec) const
+{
+    GLint handle = uniform_location(u_name);
+    glUniform4fv(handle, 1, glm::value_ptr(vec));
+}
+void ShaderProgram::set_uvec3(std::string_view u_name, const glm::uvec3& vec) const
+{
+    GLint handle = uniform_location(u_name);
+    glUniform3uiv(handle, 1, glm::value_ptr(vec));
+}
+void ShaderProgram::set_uint(std::string_view u_name, std::uint32_t u) const
 {
     GLint handle = uniform_location(u_name);
-    glUniform1i(handle, b);
+    glUniform1ui(handle, u);
 }
 
 
@@ -58,7 +74,7 @@ GLuint compile_shader(GLenum type, std::string_view src)
     return id;
 }
 
-ShaderProgram make_program(GLuint vs, GLuint fs)
+ShaderProgram make_program(GLuint vs, GLuint fs, std::span<const std::string> names)
 {
     GLuint prog = glCreateProgram();
     glAttachShader(prog, vs);
@@ -78,5 +94,5 @@ ShaderProgram make_program(GLuint vs, GLuint fs)
     glDeleteShader(vs);
     glDeleteShader(fs);
 
-    return ShaderProgram{prog};
+    return ShaderProgram{prog, names};
 }
\ No newline at end of file
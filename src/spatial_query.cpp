@@ -0,0 +1,359 @@
+#include "spatial_query.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "octree.hpp"
+#include "parallel.hpp"
+#include "state.hpp"
+
+
+namespace
+{
+constexpr std::size_t kStackSize = 8 * (Octree::kMaxDepth + 1) + 8;
+constexpr std::size_t kMinQueries = 64;
+constexpr std::size_t kMinLeaves = 256;
+
+float box_dist_sq(const glm::vec3& p, const glm::vec3& lo, const glm::vec3& hi)
+{
+    const glm::vec3 d = glm::max(glm::max(lo - p, p - hi), glm::vec3{0});
+    return dot(d, d);
+}
+
+// largest squared distance from `p` to any point of the box
+float box_far_sq(const glm::vec3& p, const glm::vec3& lo, const glm::vec3& hi)
+{
+    const glm::vec3 d = glm::max(glm::abs(lo - p), glm::abs(hi - p));
+    return dot(d, d);
+}
+
+// entry distance of the ray into the box, or +inf when it misses
+float ray_box(const glm::vec3& origin, const glm::vec3& inv_dir, const glm::vec3& lo, const glm::vec3& hi)
+{
+    const glm::vec3 t0 = (lo - origin) * inv_dir;
+    const glm::vec3 t1 = (hi - origin) * inv_dir;
+    const glm::vec3 near = glm::min(t0, t1);
+    const glm::vec3 far = glm::max(t0, t1);
+    const float enter = std::max({near.x, near.y, near.z, 0.0f});
+    const float exit = std::min({far.x, far.y, far.z});
+    return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+}
+
+// smallest t >= 0 at which the ray is inside the sphere, or +inf
+float ray_sphere(const Ray& ray, const glm::vec4& s)
+{
+    const glm::vec3 oc = ray.origin - glm::vec3{s.x, s.y, s.z};
+    const float a = dot(ray.dir, ray.dir);
+    const float b = dot(oc, ray.dir);
+    const float c = dot(oc, oc) - s.w * s.w;
+    if (c <= 0.0f)
+        return 0.0f; // starts inside
+    const float disc = b * b - a * c;
+    if (disc < 0.0f || b > 0.0f)
+        return std::numeric_limits<float>::infinity();
+    return (-b - std::sqrt(disc)) / a;
+}
+
+glm::vec3 centre_of(const glm::vec4& s)
+{
+    return {s.x, s.y, s.z};
+}
+
+bool heap_less(const Neighbour& a, const Neighbour& b)
+{
+    return a.dist_sq < b.dist_sq;
+}
+}
+
+std::shared_ptr<const SpatialSnapshot> SpatialSnapshot::capture(State& state, std::uint64_t tick)
+{
+    auto snap = std::make_shared<SpatialSnapshot>();
+    snap->taken_at = tick;
+
+    const Octree& tree = state.spatial_index();
+    const auto& src = tree.nodes();
+    if (src.empty() || src[0].total == 0)
+        return snap;
+
+    // serial pass over the nodes: depth-first body ranges, non-empty children only
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> leaves; // (snapshot node, octree leaf)
+    std::uint32_t cursor = 0;
+
+    auto emit = [&](auto&& self, std::uint32_t dst, std::uint32_t from) -> void {
+        const Octree::Node& o = src[from];
+        snap->nodes[dst].begin = cursor;
+        snap->nodes[dst].lo = o.lo - glm::vec3{o.reach};
+        snap->nodes[dst].hi = o.hi + glm::vec3{o.reach};
+
+        if (o.first_child == Octree::kNone) {
+            leaves.emplace_back(dst, from);
+            cursor += o.count;
+        } else {
+            std::uint32_t children[8];
+            std::uint32_t n = 0;
+            for (std::uint32_t oct=0; oct<8; ++oct) {
+                if (src[o.first_child + oct].total)
+                    children[n++] = o.first_child + oct;
+            }
+            const auto first = static_cast<std::uint32_t>(snap->nodes.size());
+            snap->nodes.resize(snap->nodes.size() + n);
+            snap->nodes[dst].first_child = first;
+            snap->nodes[dst].num_children = n;
+            for (std::uint32_t k=0; k<n; ++k)
+                self(self, first + k, children[k]);
+        }
+        snap->nodes[dst].end = cursor;
+    };
+    snap->nodes.reserve(src.size());
+    snap->nodes.resize(1);
+    emit(emit, 0, 0);
+
+    snap->spheres.resize(cursor);
+    snap->ids.resize(cursor);
+    parallel_for(leaves.size(), kMinLeaves, [&](std::size_t begin, std::size_t end, unsigned) {
+        for (std::size_t l=begin; l<end; ++l) {
+            std::uint32_t k = snap->nodes[leaves[l].first].begin;
+            for (const std::uint32_t body : tree.bodies(src[leaves[l].second])) {
+                const Transform& tf = state.transforms[body];
+                snap->spheres[k] = glm::vec4{tf.pos.x, tf.pos.y, tf.pos.z, tf.scale};
+                snap->ids[k] = state.ids[body];
+                ++k;
+            }
+        }
+    });
+    return snap;
+}
+
+std::optional<RayHit> SpatialSnapshot::raycast(const Ray& ray, float max_t) const
+{
+    if (nodes.empty())
+        return std::nullopt;
+
+    const glm::vec3 inv_dir = 1.0f / ray.dir;
+    float best = max_t;
+    std::uint32_t best_k = kNoBody;
+
+    std::uint32_t stack[kStackSize];
+    std::size_t top = 0;
+    if (ray_box(ray.origin, inv_dir, nodes[0].lo, nodes[0].hi) < best)
+        stack[top++] = 0;
+
+    while (top) {
+        const Node& node = nodes[stack[--top]];
+        if (node.num_children == 0) {
+            for (std::uint32_t k=node.begin; k<node.end; ++k) {
+                const float t = ray_sphere(ray, spheres[k]);
+                if (t < best) {
+                    best = t;
+                    best_k = k;
+                }
+            }
+            continue;
+        }
+
+        // push hit children farthest first so the nearest is searched first
+        std::pair<float, std::uint32_t> hit[8];
+        std::uint32_t n = 0;
+        for (std::uint32_t c=node.first_child; c<node.first_child + node.num_children; ++c) {
+            const float t = ray_box(ray.origin, inv_dir, nodes[c].lo, nodes[c].hi);
+            if (t < best)
+                hit[n++] = {t, c};
+        }
+        std::sort(hit, hit + n, [](const auto& a, const auto& b) { return a.first > b.first; });
+        for (std::uint32_t k=0; k<n; ++k)
+            stack[top++] = hit[k].second;
+    }
+
+    if (best_k == kNoBody)
+        return std::nullopt;
+    return RayHit{ids[best_k], best};
+}
+
+std::size_t SpatialSnapshot::nearest(const glm::vec3& p, std::span<Neighbour> out) const
+{
+    const std::size_t k = out.size();
+    std::size_t count = 0;
+    if (k == 0 || nodes.empty())
+        return 0;
+
+    // max-heap of the best k so far, worst on top
+    const auto worst = [&] {
+        return count < k ? std::numeric_limits<float>::infinity() : out[0].dist_sq;
+    };
+
+    std::uint32_t stack[kStackSize];
+    std::size_t top = 0;
+    stack[top++] = 0;
+
+    while (top) {
+        const Node& node = nodes[stack[--top]];
+        if (box_dist_sq(p, node.lo, node.hi) >= worst())
+            continue;
+
+        if (node.num_children == 0) {
+            for (std::uint32_t b=node.begin; b<node.end; ++b) {
+                const glm::vec3 d = centre_of(spheres[b]) - p;
+                const Neighbour nb{ids[b], dot(d, d)};
+                if (count < k) {
+                    out[count++] = nb;
+                    std::push_heap(out.begin(), out.begin() + count, heap_less);
+                } else if (nb.dist_sq < out[0].dist_sq) {
+                    std::pop_heap(out.begin(), out.begin() + count, heap_less);
+                    out[count - 1] = nb;
+                    std::push_heap(out.begin(), out.begin() + count, heap_less);
+                }
+            }
+            continue;
+        }
+
+        std::pair<float, std::uint32_t> near[8];
+        std::uint32_t n = 0;
+        for (std::uint32_t c=node.first_child; c<node.first_child + node.num_children; ++c)
+            near[n++] = {box_dist_sq(p, nodes[c].lo, nodes[c].hi), c};
+        std::sort(near, near + n, [](const auto& a, const auto& b) { return a.first > b.first; });
+        for (std::uint32_t i=0; i<n; ++i)
+            stack[top++] = near[i].second;
+    }
+
+    std::sort_heap(out.begin(), out.begin() + count, heap_less);
+    std::fill(out.begin() + count, out.end(), Neighbour{kNoBody, std::numeric_limits<float>::infinity()});
+    return count;
+}
+
+void SpatialSnapshot::within_radius(const glm::vec3& c, float radius, std::vector<std::uint32_t>& out) const
+{
+    if (nodes.empty())
+        return;
+
+    const float r_sq = radius * radius;
+    std::uint32_t stack[kStackSize];
+    std::size_t top = 0;
+    stack[top++] = 0;
+
+    while (top) {
+        const Node& node = nodes[stack[--top]];
+        if (box_dist_sq(c, node.lo, node.hi) > r_sq)
+            continue;
+
+        if (box_far_sq(c, node.lo, node.hi) <= r_sq) {
+            out.insert(out.end(), ids.begin() + node.begin, ids.begin() + node.end);
+        } else if (node.num_children == 0) {
+            for (std::uint32_t b=node.begin; b<node.end; ++b) {
+                const glm::vec3 d = centre_of(spheres[b]) - c;
+                if (dot(d, d) <= r_sq)
+                    out.push_back(ids[b]);
+            }
+        } else {
+            for (std::uint32_t ch=node.first_child; ch<node.first_child + node.num_children; ++ch)
+                stack[top++] = ch;
+        }
+    }
+}
+
+std::size_t SpatialSnapshot::count_within_radius(const glm::vec3& c, float radius) const
+{
+    if (nodes.empty())
+        return 0;
+
+    const float r_sq = radius * radius;
+    std::size_t count = 0;
+    std::uint32_t stack[kStackSize];
+    std::size_t top = 0;
+    stack[top++] = 0;
+
+    while (top) {
+        const Node& node = nodes[stack[--top]];
+        if (box_dist_sq(c, node.lo, node.hi) > r_sq)
+            continue;
+
+        if (box_far_sq(c, node.lo, node.hi) <= r_sq) {
+            count += node.end - node.begin;
+        } else if (node.num_children == 0) {
+            for (std::uint32_t b=node.begin; b<node.end; ++b) {
+                const glm::vec3 d = centre_of(spheres[b]) - c;
+                count += dot(d, d) <= r_sq;
+            }
+        } else {
+            for (std::uint32_t ch=node.first_child; ch<node.first_child + node.num_children; ++ch)
+                stack[top++] = ch;
+        }
+    }
+    return count;
+}
+
+std::size_t SpatialSnapshot::count_in_box(const glm::vec3& lo, const glm::vec3& hi) const
+{
+    if (nodes.empty())
+        return 0;
+
+    const auto contains = [&](const glm::vec3& p) {
+        return p.x >= lo.x && p.y >= lo.y && p.z >= lo.z && p.x <= hi.x && p.y <= hi.y && p.z <= hi.z;
+    };
+
+    std::size_t count = 0;
+    std::uint32_t stack[kStackSize];
+    std::size_t top = 0;
+    stack[top++] = 0;
+
+    while (top) {
+        const Node& node = nodes[stack[--top]];
+        const bool disjoint = node.hi.x < lo.x || node.hi.y < lo.y || node.hi.z < lo.z
+                           || node.lo.x > hi.x || node.lo.y > hi.y || node.lo.z > hi.z;
+        if (disjoint)
+            continue;
+
+        if (contains(node.lo) && contains(node.hi)) {
+            count += node.end - node.begin;
+        } else if (node.num_children == 0) {
+            for (std::uint32_t b=node.begin; b<node.end; ++b)
+                count += contains(centre_of(spheres[b]));
+        } else {
+            for (std::uint32_t ch=node.first_child; ch<node.first_child + node.num_children; ++ch)
+                stack[top++] = ch;
+        }
+    }
+    return count;
+}
+
+void SpatialSnapshot::raycast(std::span<const Ray> rays, std::span<std::optional<RayHit>> hits) const
+{
+    parallel_for(rays.size(), kMinQueries, [&](std::size_t begin, std::size_t end, unsigned) {
+        for (std::size_t q=begin; q<end; ++q)
+            hits[q] = raycast(rays[q]);
+    });
+}
+
+void SpatialSnapshot::nearest(std::span<const glm::vec3> points, std::size_t k, std::span<Neighbour> out) const
+{
+    parallel_for(points.size(), kMinQueries, [&](std::size_t begin, std::size_t end, unsigned) {
+        for (std::size_t q=begin; q<end; ++q)
+            nearest(points[q], out.subspan(q * k, k));
+    });
+}
+
+void SpatialSnapshot::count_within_radius(std::span<const glm::vec3> centres, float radius,
+                                          std::span<std::uint32_t> counts) const
+{
+    parallel_for(centres.size(), kMinQueries, [&](std::size_t begin, std::size_t end, unsigned) {
+        for (std::size_t q=begin; q<end; ++q)
+            counts[q] = static_cast<std::uint32_t>(count_within_radius(centres[q], radius));
+    });
+}
+
+
+void SpatialQueries::publish(State& state, std::uint64_t tick)
+{
+    std::shared_ptr<const SpatialSnapshot> next = SpatialSnapshot::capture(state, tick);
+    {
+        std::lock_guard lock(mtx);
+        std::swap(current, next);
+    }
+    // the previous snapshot, if no reader holds it any more, is freed outside the lock
+}
+
+std::shared_ptr<const SpatialSnapshot> SpatialQueries::snapshot() const
+{
+    std::lock_guard lock(mtx);
+    return current;
+}
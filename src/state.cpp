@@ -2,30 +2,134 @@
 
 #include <glm/glm.hpp>
 
-#include "constants.hpp"
+#include "domain.hpp"
+#include "parallel.hpp"
 
-constexpr float G = 10.0f;
 
+namespace
+{
+constexpr std::size_t kMinRows  = 64;       // each row of the pair sum is O(n)
+constexpr std::size_t kMinChunk = 1 << 14;
+}
+
+
+State::State() = default;
+State::~State() = default;
+
+State::State(State&&) noexcept            = default;
+State& State::operator=(State&&) noexcept = default;
+
+void State::enable_domains(DomainConfig config)
+{
+    domains = std::make_unique<DomainDecomposition>(*this, config);
+}
+
+std::uint32_t State::add_body(const Transform& tf, const PhysicsProps& p, const glm::vec3& colour)
+{
+    const auto id = static_cast<std::uint32_t>(index_of.size());
+    index_of.push_back(static_cast<std::uint32_t>(transforms.size()));
+    ids.push_back(id);
+    transforms.push_back(tf);
+    props.push_back(p);
+    albedo.push_back(colour);
+    octree.invalidate();
+    return id;
+}
+
+std::size_t State::append_bodies(std::size_t count, std::uint32_t mesh_id)
+{
+    const std::size_t first = transforms.size();
+    const auto first_id = static_cast<std::uint32_t>(index_of.size());
+
+    transforms.resize(first + count);
+    props.resize(first + count);
+    ids.resize(first + count);
+    index_of.resize(first_id + count);
+    albedo.resize(first_id + count);
+    models.reserve(models.size() + count);
+
+    for (std::size_t k=0; k<count; ++k) {
+        const auto id = static_cast<std::uint32_t>(first_id + k);
+        ids[first + k] = id;
+        index_of[id] = static_cast<std::uint32_t>(first + k);
+        models.emplace(Model{id, mesh_id, false});
+    }
+    octree.invalidate();
+    return first;
+}
+
+void State::reorder(SpaceCurve curve)
+{
+    reorderer.apply(*this, curve);
+    octree.invalidate();
+}
+
+void State::set_light_source(std::size_t model, bool on)
+{
+    if (models[model].is_light_source == on)
+        return;
+    models[model].is_light_source = on;
+    ++light_changes;
+}
+
+const Octree& State::spatial_index()
+{
+    octree.update(*this, arena);
+    return octree;
+}
 
 void State::tick(float dt)
 {
-    for (std::size_t i=0; i<kNumObjects; ++i) {
-        PhysicsProps& p = props[i];
-        Transform& tf = transforms[i];
+    arena.reset();
 
-        glm::vec3 force{0};
-        for (std::size_t j=0; j<kNumObjects; ++j) {
-            if (i == j) continue;
-            
-            glm::vec3 r_vec = transforms[j].pos - tf.pos;
-            float r_sq = dot(r_vec, r_vec);
-            float r = sqrt(r_sq);
+    if (domains)
+        domains->tick(*this, dt);
+    else
+        tick_direct(dt);
+    octree.mark_moved();
 
-            float force_mag = G * p.mass * props[j].mass / r_sq;
-            force += force_mag * r_vec / r;
-        }
- 
-        p.vel += (force / p.mass) * dt; // apply acceleration
-        tf.pos += p.vel * dt;
+    if (reorder_config.interval_ticks && ++ticks_since_reorder >= reorder_config.interval_ticks) {
+        reorder(reorder_config.curve);
+        ticks_since_reorder = 0;
     }
-}
\ No newline at end of file
+}
+
+// Jacobi step: every acceleration is taken from the same positions, so rows are
+// independent and split across the pool. The law is inlined into the inner loop,
+// pair terms come from the exact sum or, with an opening angle, from the octree.
+void State::tick_direct(float dt)
+{
+    const std::size_t n = transforms.size();
+    glm::vec3* acc = arena.shared().alloc_array<glm::vec3>(n);
+    const Octree* tree = opening_angle > 0.0f ? &spatial_index() : nullptr;
+
+    parallel_for(n, kMinRows, [&](std::size_t begin, std::size_t end, unsigned) {
+        for (std::size_t i=begin; i<end; ++i) {
+            const PhysicsProps& p = props[i];
+            const glm::vec3 pos = transforms[i].pos;
+
+            glm::vec3 a = body_accel(kForceLaw, p, pos);
+            if constexpr (HasPair<ForceLaw, PhysicsProps>) {
+                if (tree) {
+                    a += tree->accel(kForceLaw, static_cast<std::uint32_t>(i), transforms.data(), props.data(),
+                                     opening_angle);
+                } else {
+                    for (std::size_t j=0; j<n; ++j) {
+                        if (i == j) continue;
+
+                        const glm::vec3 r_vec = transforms[j].pos - pos;
+                        a += pair_accel(kForceLaw, p, props[j], r_vec, dot(r_vec, r_vec));
+                    }
+                }
+            }
+            acc[i] = a;
+        }
+    });
+
+    parallel_for(n, kMinChunk, [&](std::size_t begin, std::size_t end, unsigned) {
+        for (std::size_t i=begin; i<end; ++i) {
+            props[i].vel += acc[i] * dt;
+            transforms[i].pos += props[i].vel * dt;
+        }
+    });
+}
@@ -0,0 +1,174 @@
+#include "trails.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <glad/glad.h>
+
+#include "parallel.hpp"
+#include "read_file_to_string.hpp"
+#include "state.hpp"
+
+
+namespace
+{
+// samples that can be recorded while a drawn frame is still in flight
+constexpr std::uint32_t kSlackSlots = 16;
+constexpr GLuint kSamplesBinding = 4;
+constexpr std::size_t kMinChunk = 1 << 14;
+constexpr GLuint64 kFenceTimeoutNs = 1'000'000'000ull;
+
+ShaderProgram load_trail_shader()
+{
+    return make_program(
+        compile_shader(GL_VERTEX_SHADER,   read_file_to_string("shaders/trail/trail.vert")),
+        compile_shader(GL_FRAGMENT_SHADER, read_file_to_string("shaders/trail/trail.frag")),
+        trail_uniform_names
+    );
+}
+
+std::uint32_t pack_colour(const glm::vec3& c)
+{
+    const auto channel = [](float v) {
+        return static_cast<std::uint32_t>(std::lround(std::clamp(v, 0.0f, 1.0f) * 255.0f));
+    };
+    return channel(c.x) | channel(c.y) << 8 | channel(c.z) << 16 | 0xFFu << 24;
+}
+
+void wait_fence(GLsync fence)
+{
+    GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, kFenceTimeoutNs);
+    while (status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(fence, 0, kFenceTimeoutNs);
+    glDeleteSync(fence);
+    if (status == GL_WAIT_FAILED)
+        throw std::runtime_error("waiting for trail buffer fence failed");
+}
+}
+
+OrbitTrails::OrbitTrails(TrailConfig config)
+    : cfg(config),
+      program{load_trail_shader()},
+      slots(config.length + kSlackSlots)
+{
+    if (cfg.length < 2 || cfg.interval_ticks == 0)
+        throw std::runtime_error("trails need at least 2 samples and a non-zero interval");
+
+    glCreateVertexArrays(1, &vao);
+}
+
+OrbitTrails::~OrbitTrails()
+{
+    retire_fences(0, true);
+    release();
+    if (vao)
+        glDeleteVertexArrays(1, &vao);
+}
+
+void OrbitTrails::release()
+{
+    if (buffer) {
+        glUnmapNamedBuffer(buffer);
+        glDeleteBuffers(1, &buffer);
+    }
+    buffer = 0;
+    mapped = nullptr;
+    stride = 0;
+}
+
+// waits for draws that saw at most `up_to` samples, or for every draw
+void OrbitTrails::retire_fences(std::uint64_t up_to, bool all)
+{
+    while (!in_flight.empty() && (all || in_flight.front().second <= up_to)) {
+        wait_fence(in_flight.front().first);
+        in_flight.pop_front();
+    }
+}
+
+void OrbitTrails::resize(std::size_t bodies)
+{
+    retire_fences(0, true);
+    num_bodies = bodies;
+    written = 0;
+    ticks_since_sample = 0;
+    if (bodies <= stride)
+        return;
+
+    const std::size_t grown = stride ? std::max(bodies, stride + stride / 2) : bodies;
+    release();
+    stride = grown;
+    const auto total = static_cast<GLsizeiptr>(memory_bytes());
+
+    constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, total, nullptr, flags);
+    mapped = static_cast<TrailSample*>(glMapNamedBufferRange(buffer, 0, total, flags));
+    if (!mapped)
+        throw std::runtime_error("failed to map trail buffer");
+}
+
+void OrbitTrails::record(const State& state)
+{
+    const std::size_t n = state.index_of.size();
+    if (n != num_bodies)
+        resize(n);
+    if (n == 0)
+        return;
+
+    // the first sample after a reset is taken straight away
+    if (written && ++ticks_since_sample < cfg.interval_ticks)
+        return;
+    ticks_since_sample = 0;
+
+    // this slot last held sample `written - slots`, drawn by frames that saw up to `written - slack` samples
+    if (written >= kSlackSlots)
+        retire_fences(written - kSlackSlots, false);
+
+    TrailSample* slot = mapped + (written % slots) * stride;
+    parallel_for(n, kMinChunk, [&](std::size_t begin, std::size_t end, unsigned) {
+        for (std::size_t id=begin; id<end; ++id) {
+            const glm::vec3& pos = state.transforms[state.index_of[id]].pos;
+            slot[id] = TrailSample{pos, pack_colour(state.albedo[id])};
+        }
+    });
+    ++written;
+}
+
+void OrbitTrails::draw(const glm::mat4& vp)
+{
+    // drop fences that have already passed, so a paused simulation doesn't pile them up
+    while (!in_flight.empty()) {
+        const GLenum status = glClientWaitSync(in_flight.front().first, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        glDeleteSync(in_flight.front().first);
+        in_flight.pop_front();
+    }
+
+    const auto samples = static_cast<std::uint32_t>(std::min<std::uint64_t>(written, cfg.length));
+    if (samples < 2)
+        return;
+
+    glUseProgram(program.id);
+    program.set_mat4("u_vp", vp);
+    program.set_uint("u_trail_newest", static_cast<std::uint32_t>((written - 1) % slots));
+    program.set_uint("u_trail_slots", slots);
+    program.set_uint("u_trail_samples", samples);
+    program.set_uint("u_trail_stride", static_cast<std::uint32_t>(stride));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kSamplesBinding, buffer);
+
+    // blended, depth-tested against the bodies but not written, so strips never hide each other
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+
+    glBindVertexArray(vao);
+    glDrawArraysInstanced(GL_LINE_STRIP, 0, static_cast<GLsizei>(samples), static_cast<GLsizei>(num_bodies));
+    glBindVertexArray(0);
+
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+
+    in_flight.emplace_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), written);
+}
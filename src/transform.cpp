@@ -1,5 +1,7 @@
 #include "transform.hpp"
 
+#include <cmath>
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
@@ -11,13 +13,27 @@ glm::mat4 Transform::to_model_mat4() const {
          * glm::scale(glm::mat4(1.0f), glm::vec3(scale));
 }
 
+glm::quat nlerp(const glm::quat& a, const glm::quat& b, float alpha)
+{
+    const float sign = (a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w) < 0.0f ? -1.0f : 1.0f;
+    glm::quat q{
+        a.w + alpha * (sign * b.w - a.w),
+        a.x + alpha * (sign * b.x - a.x),
+        a.y + alpha * (sign * b.y - a.y),
+        a.z + alpha * (sign * b.z - a.z),
+    };
+    const float inv_len = 1.0f / std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+    q.w *= inv_len; q.x *= inv_len; q.y *= inv_len; q.z *= inv_len;
+    return q;
+}
+
 Transform interpolate(const Transform& a,
                       const Transform& b,
                       float alpha)
 {
     return Transform{
         glm::mix(a.pos, b.pos, alpha),
-        glm::slerp(a.rot, b.rot, alpha),
+        nlerp(a.rot, b.rot, alpha),
         (1.0f - alpha) * a.scale + alpha * b.scale
     };
 }
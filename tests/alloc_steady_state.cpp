@@ -0,0 +1,106 @@
+// Steady-state allocation check: after a few warm-up ticks, State::tick must not
+// reach the global heap at all. Global operator new is replaced to count every
+// allocation, from any thread, made while `counting` is set.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include "generators.hpp"
+#include "state.hpp"
+
+
+namespace
+{
+std::atomic<bool> counting{false};
+std::atomic<std::uint64_t> allocations{0};
+
+void* counted_alloc(std::size_t bytes, std::size_t align)
+{
+    if (counting.load(std::memory_order_relaxed))
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    if (bytes == 0)
+        bytes = 1;
+    return align > alignof(std::max_align_t)
+        ? std::aligned_alloc(align, (bytes + align - 1) / align * align)
+        : std::malloc(bytes);
+}
+
+constexpr unsigned kWarmupTicks = 8;
+constexpr unsigned kCheckedTicks = 64;
+constexpr float kDt = 1.0f / 120.0f;
+
+struct Case {
+    const char* name;
+    float opening_angle;
+    std::uint32_t reorder_interval;
+};
+
+bool run(const Case& c)
+{
+    State state;
+    state.opening_angle = c.opening_angle;
+    state.reorder_config.interval_ticks = c.reorder_interval;
+    generate_plummer(state, PlummerParams{.count = 4096}, 1);
+
+    for (unsigned t=0; t<kWarmupTicks; ++t) {
+        state.swap();
+        state.tick(kDt);
+    }
+
+    allocations = 0;
+    counting = true;
+    for (unsigned t=0; t<kCheckedTicks; ++t) {
+        state.swap();
+        state.tick(kDt);
+    }
+    counting = false;
+
+    const std::uint64_t seen = allocations;
+    std::cout << c.name << ": " << seen << " allocations over " << kCheckedTicks << " ticks" << std::endl;
+    return seen == 0;
+}
+}
+
+void* operator new(std::size_t bytes)
+{
+    if (void* p = counted_alloc(bytes, 0))
+        return p;
+    throw std::bad_alloc{};
+}
+void* operator new[](std::size_t bytes) { return operator new(bytes); }
+void* operator new(std::size_t bytes, std::align_val_t align)
+{
+    if (void* p = counted_alloc(bytes, static_cast<std::size_t>(align)))
+        return p;
+    throw std::bad_alloc{};
+}
+void* operator new[](std::size_t bytes, std::align_val_t align) { return operator new(bytes, align); }
+void* operator new(std::size_t bytes, const std::nothrow_t&) noexcept { return counted_alloc(bytes, 0); }
+void* operator new[](std::size_t bytes, const std::nothrow_t&) noexcept { return counted_alloc(bytes, 0); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+
+int main()
+{
+    constexpr Case cases[] = {
+        {"direct sum",       0.0f, 0},
+        {"octree",           0.7f, 0},
+        {"octree + reorder", 0.7f, 5},
+    };
+
+    bool ok = true;
+    for (const Case& c : cases)
+        ok = run(c) && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,70 @@
+// Domain decomposition parity: with an opening angle of 0 the forked domains sum
+// every pair exactly, so after K ticks each body must sit where the single-process
+// State::tick puts it. Pair sums run in a different order across domains, so the
+// positions are compared with a tolerance rather than bit for bit.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+#include <glm/glm.hpp>
+
+#include "generators.hpp"
+#include "state.hpp"
+
+
+namespace
+{
+constexpr std::size_t kBodies = 2048;
+constexpr std::uint64_t kSeed = 7;
+constexpr unsigned kTicks = 32;
+constexpr float kDt = 1.0f / 120.0f;
+constexpr float kScaleRadius = 5.0f;
+// largest allowed position difference, relative to the Plummer scale radius
+constexpr float kTolerance = 1e-4f;
+
+void make_scene(State& state)
+{
+    generate_plummer(state, PlummerParams{.count = kBodies, .scale_radius = kScaleRadius}, kSeed);
+}
+
+bool check(std::uint32_t num_domains, std::uint32_t reorder_interval)
+{
+    State reference, split;
+    make_scene(reference);
+    make_scene(split);
+    reference.reorder_config.interval_ticks = reorder_interval;
+    split.reorder_config.interval_ticks = reorder_interval;
+    split.enable_domains(DomainConfig{.num_domains = num_domains});
+
+    for (unsigned t=0; t<kTicks; ++t) {
+        reference.tick(kDt);
+        split.tick(kDt);
+    }
+
+    float worst = 0.0f;
+    for (std::uint32_t id=0; id<kBodies; ++id) {
+        const glm::vec3 a = reference.transforms[reference.index_of[id]].pos;
+        const glm::vec3 b = split.transforms[split.index_of[id]].pos;
+        worst = std::max(worst, glm::length(a - b));
+    }
+
+    const bool ok = worst <= kTolerance * kScaleRadius;
+    std::cout << num_domains << " domains, reorder every " << reorder_interval
+              << ": max position difference " << worst
+              << " after " << kTicks << " ticks (limit " << kTolerance * kScaleRadius << ")" << std::endl;
+    return ok;
+}
+}
+
+
+int main()
+{
+    bool ok = true;
+    for (std::uint32_t domains : {1u, 2u, 4u})
+        ok = check(domains, 0) && ok;
+    // the kept slot order has to stay consistent across State's reordering
+    ok = check(4, 4) && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "force_laws.hpp"
+
+// Compile-only builds select one documented composition by id, see tests/CMakeLists.txt.
+// Keep in sync with the examples in physics_config.hpp.
+#if SPACESIM_FORCE_LAW_CHECK == 0
+inline constexpr auto kForceLaw = Gravity<Unsoftened>{};
+#elif SPACESIM_FORCE_LAW_CHECK == 1
+inline constexpr auto kForceLaw = Gravity<Softened>{.softening = {0.1f}} + Drag{0.02f};
+#elif SPACESIM_FORCE_LAW_CHECK == 2
+inline constexpr auto kForceLaw = Gravity<>{} + Coulomb<>{.k = 5.0f} + CentralPotential<>{.gm = 500.0f};
+#elif SPACESIM_FORCE_LAW_CHECK == 3
+inline constexpr auto kForceLaw = Drag{};
+#elif SPACESIM_FORCE_LAW_CHECK == 4
+inline constexpr auto kForceLaw = CentralPotential<>{} + Drag{};
+#else
+#error "unknown SPACESIM_FORCE_LAW_CHECK"
+#endif
+
+static_assert(ForceLawType<std::remove_cv_t<decltype(kForceLaw)>>);